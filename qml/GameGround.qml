@@ -34,62 +34,14 @@ Item {
         }
     }
 
-    Grid {
+    MapView {
         id: gameGrid
 
         anchors.centerIn: parent
-        spacing: 0
 
-        columns: Backend.columns
-        rows: Backend.rows
-
-        Repeater {
-            model: Backend.map
-
-            Rectangle {
-                id: cell
-
-                color: model.tileColor
-                clip: true
-
-                border.color: "black"
-                border.width: 1
-
-                width: gameGround.cellSize
-                height: gameGround.cellSize
-
-                Image {
-                    id: tileImage
-
-                    anchors.fill: parent
-                    source: Backend.imageUrl(model.tileImageSource, model.tileImageCount, Backend.ticks)
-                    sourceSize: Qt.size(width, height)
-                    visible: source.toString()
-                }
-
-                Image {
-                    id: itemImage
-
-                    anchors.fill: parent
-                    source: Backend.imageUrl(model.itemImageSource, model.itemImageCount, Backend.ticks)
-                    sourceSize: Qt.size(width, height)
-                    visible: source.toString()
-                }
-
-                Rectangle {
-                    id: itemCircle
-
-                    anchors.centerIn: parent
-
-                    radius: parent.width/2 - 4
-                    width: 2 * radius
-                    height: 2 * radius
-
-                    color: model.itemColor
-                    visible: model.itemType && !model.isStart && !itemImage.visible || false
-                }
-            }
-        }
+        map: Backend.map
+        cellSize: gameGround.cellSize
+        clock: Backend.animationClock
     }
 
     Item {
@@ -154,17 +106,13 @@ Item {
                         visible: source.toString()
 
                         rotation: {
-                            if (actorView.actor.rotationSteps > 1) {
-                                let step = Backend.ticks % actorView.actor.rotationSteps;
-                                return 360 * step / actorView.actor.rotationSteps;
-                            }
+                            if (actorView.actor.rotationSteps > 1)
+                                return 360 * actorView.actor.rotationStep / actorView.actor.rotationSteps;
 
                             return 0;
                         }
 
-                        source: Backend.imageUrl(actorView.actor.imageSource,
-                                                 actorView.actor.imageCount,
-                                                 Backend.ticks)
+                        source: actorView.actor.frameSource
                     }
 
                     Rectangle {
@@ -6,22 +6,99 @@
 #include <QJsonArray>
 #include <QJsonObject>
 
+#include <algorithm>
+#include <array>
+
+using namespace Qt::StringLiterals;
+
 namespace GameOne {
 
-Actor::Actor(QJsonObject spec, Backend *backend)
+namespace {
+
+// the fields of an actor specification that make up its prototype
+constexpr auto PrototypeFields = std::array{
+    "name"_L1, "type"_L1, "color"_L1, "energyLevels"_L1, "minimumEnergy"_L1, "maximumEnergy"_L1,
+    "maximumLives"_L1, "image"_L1, "imageCount"_L1, "rotationSteps"_L1,
+};
+
+} // namespace
+
+ActorPrototype::ActorPrototype(const QJsonObject &spec, const Backend &backend)
+    : name{spec["name"].toString()}
+    , type{spec["type"].toString()}
+    , color{spec["color"].toString()}
+    , minimumEnergy{spec["minimumEnergy"].toInt()}
+    , maximumEnergy{qMax(spec["maximumEnergy"].toInt(), 1)}
+    , maximumLives{qMax(spec["maximumLives"].toInt(), 1)}
+    , imageSource{Backend::imageUrl(spec["image"].toString())}
+    , imageCount{spec["imageCount"].toInt()}
+    , frames{backend.frameTable(imageSource, imageCount)}
+    , rotationSteps{spec["rotationSteps"].toInt()}
+{
+    for (const auto &value: spec["energyLevels"].toArray()) {
+        const auto level = value.toObject();
+        const auto minimumEnergy = static_cast<qreal>(level["minimumEnergy"].toDouble());
+        const auto levelImageSource = Backend::imageUrl(level["image"].toString());
+        const auto levelImageCount = level["imageCount"].toInt();
+
+        const auto effectiveImageSource = levelImageSource.isEmpty() ? imageSource : levelImageSource;
+        const auto effectiveImageCount = levelImageCount > 0 ? levelImageCount : imageCount;
+
+        energyLevels.append({minimumEnergy, effectiveImageSource, effectiveImageCount,
+                             backend.frameTable(effectiveImageSource, effectiveImageCount)});
+    }
+
+    const auto byDescendingEnergy = [](const auto &lhs, const auto &rhs) {
+        return lhs.minimumEnergy > rhs.minimumEnergy;
+    };
+
+    std::sort(energyLevels.begin(), energyLevels.end(), byDescendingEnergy);
+
+    for (const auto field : PrototypeFields) {
+        if (const auto it = spec.constFind(field); it != spec.constEnd())
+            fields.insert(field, *it);
+    }
+}
+
+bool ActorPrototype::matches(const QJsonObject &spec) const
+{
+    return std::all_of(PrototypeFields.begin(), PrototypeFields.end(), [this, &spec](auto field) {
+        return spec.value(field) == fields.value(field);
+    });
+}
+
+QList<QUrl> ActorPrototype::imageUrls() const
+{
+    // the first frame of an animation stands for all of its frames
+    QList<QUrl> urls;
+
+    if (!frames.isEmpty())
+        urls.append(frames.first());
+
+    for (const auto &level : energyLevels) {
+        if (!level.frames.isEmpty())
+            urls.append(level.frames.first());
+    }
+
+    return urls;
+}
+
+Actor::Actor(ActorKind kind, QJsonObject spec, Backend *backend)
     : QObject{backend}
-    , m_name{spec["name"].toString()}
+    , m_prototype{backend->prototype(spec)}
+    , m_backend{backend}
+    , m_store{backend->actorStore()}
+    , m_name{m_prototype->name}
     , m_origin{spec["x"].toInt(), spec["y"].toInt()}
-    , m_position{m_origin}
-    , m_energyLevels{makeEnergyLevels(spec["energyLevels"].toArray())}
-    , m_minimumEnergy{spec["minimumEnergy"].toInt()}
-    , m_maximumEnergy{qMax(spec["maximumEnergy"].toInt(), 1)}
-    , m_maximumLives{qMax(spec["maximumLives"].toInt(), 1)}
-    , m_lives{m_maximumLives}
-    , m_imageSource{Backend::imageUrl(spec["image"].toString())}
-    , m_imageCount{spec["imageCount"].toInt()}
-    , m_rotationSteps{spec["rotationSteps"].toInt()}
+    , m_index{m_store->append(kind, m_origin, m_prototype->maximumLives)}
+    , m_random{backend->makeRandom()}
 {
+    m_rotationCounter = backend->animationClock()->counter(m_prototype->rotationSteps);
+
+    if (m_rotationCounter)
+        connect(m_rotationCounter, &FrameCounter::frameChanged, this, [this] { notify(Change::Rotation); });
+
+    updateFrames();
     respawn();
 }
 
@@ -33,89 +110,136 @@ void Actor::setName(const QString &name)
 
 QUrl Actor::imageSource() const
 {
-    if (const auto level = currentEnergyLevel(); level != m_energyLevels.end() && !level->imageSource.isEmpty())
+    if (const auto level = currentEnergyLevel(); level != m_prototype->energyLevels.end())
         return level->imageSource;
 
-    return m_imageSource;
+    return m_prototype->imageSource;
 }
 
 int Actor::imageCount() const
 {
-    if (const auto level = currentEnergyLevel(); level != m_energyLevels.end() && level->imageCount > 0)
+    if (const auto level = currentEnergyLevel(); level != m_prototype->energyLevels.end())
         return level->imageCount;
 
-    return m_imageCount;
+    return m_prototype->imageCount;
 }
 
-void Actor::giveBonus(Actor *actor, int amount)
+QList<QUrl> Actor::imageUrls() const
 {
-    actor->giveEnergy(amount);
+    return m_prototype->imageUrls();
 }
 
-Backend *Actor::backend() const
+QUrl Actor::frameSource() const
+{
+    return m_frames.value(m_frameCounter ? m_frameCounter->frame() : 0);
+}
+
+int Actor::rotationStep() const
+{
+    return m_rotationCounter ? m_rotationCounter->frame() : 0;
+}
+
+void Actor::giveBonus(Actor *actor, int amount)
 {
-    return dynamic_cast<Backend *>(parent());
+    actor->giveEnergy(amount);
 }
 
 void Actor::setEnergy(int energy)
 {
-    if (std::exchange(m_energy, energy) != m_energy) {
+    if (energy != this->energy()) {
         const auto oldImageSource = imageSource();
         const auto oldImageCount = imageCount();
+        auto changes = Changes{Change::Energy};
+
+        m_store->setEnergy(m_index, energy);
+
+        if (imageSource() != oldImageSource)
+            changes |= Change::ImageSource;
+        if (imageCount() != oldImageCount)
+            changes |= Change::ImageCount;
 
-        m_energy = energy;
-        emit energyChanged(m_energy);
+        if (changes.testAnyFlags(Change::ImageSource | Change::ImageCount)) {
+            updateFrames();
+            changes |= Change::Frame;
+        }
 
-        if (const auto newImageSource = imageSource(); newImageSource != oldImageSource)
-            emit imageSourceChanged(newImageSource);
-        if (const auto newImageCount = imageCount(); newImageCount != oldImageCount)
-            emit imageCountChanged(newImageCount);
+        notify(changes);
 
-        if (m_energy == 0)
+        if (energy == 0)
             die();
     }
 }
 
-QList<Actor::EnergyLevel> Actor::makeEnergyLevels(const QJsonArray &array)
+void Actor::updateFrames()
 {
-    QList<Actor::EnergyLevel> levels;
+    // only animated images follow a frame counter, static images don't need any updates
 
-    for (const auto &value: array) {
-        const auto spec = value.toObject();
-        const auto minimumEnergy = static_cast<qreal>(spec["minimumEnergy"].toDouble());
-        const auto imageSource = Backend::imageUrl(spec["image"].toString());
-        const auto imageCount = spec["imageCount"].toInt();
-        levels.append({minimumEnergy, imageSource, imageCount});
-    }
+    const auto level = currentEnergyLevel();
+    m_frames = level != m_prototype->energyLevels.end() ? level->frames : m_prototype->frames;
+    auto *const counter = backend()->animationClock()->counter(static_cast<int>(m_frames.size()));
 
-    const auto byDescendingEnergy = [](const auto &lhs, const auto &rhs) {
-        return lhs.minimumEnergy > rhs.minimumEnergy;
-    };
+    if (m_frameCounter == counter)
+        return;
+
+    disconnect(m_frameConnection);
+    m_frameCounter = counter;
+
+    if (counter)
+        m_frameConnection = connect(counter, &FrameCounter::frameChanged, this, [this] { notify(Change::Frame); });
+}
 
-    std::sort(levels.begin(), levels.end(), byDescendingEnergy);
+void Actor::notify(Changes changes)
+{
+    const auto pendingChanges = std::exchange(m_pendingChanges, m_pendingChanges | changes);
 
-    return levels;
+    if (auto *const backend = this->backend(); backend != nullptr && backend->isBatching()) {
+        if (pendingChanges == Changes{})
+            backend->markDirty(this);
+    } else {
+        flushChanges();
+    }
 }
 
-QList<Actor::EnergyLevel>::ConstIterator Actor::currentEnergyLevel() const
+void Actor::flushChanges()
+{
+    const auto changes = std::exchange(m_pendingChanges, Changes{});
+
+    if (changes.testFlag(Change::Position))
+        emit positionChanged(position());
+    if (changes.testFlag(Change::Energy))
+        emit energyChanged(energy());
+    if (changes.testFlag(Change::ImageSource))
+        emit imageSourceChanged(imageSource());
+    if (changes.testFlag(Change::ImageCount))
+        emit imageCountChanged(imageCount());
+    if (changes.testFlag(Change::Lives))
+        emit livesChanged(lives());
+    if (changes.testFlag(Change::Frame))
+        emit frameSourceChanged(frameSource());
+    if (changes.testFlag(Change::Rotation))
+        emit rotationStepChanged(rotationStep());
+}
+
+QList<ActorPrototype::EnergyLevel>::ConstIterator Actor::currentEnergyLevel() const
 {
     const auto fitsCurrentLevel = [current = energy(), maximum = maximumEnergy()](const auto &level) {
         return current >= level.minimumEnergy * maximum;
     };
 
-    return std::find_if(m_energyLevels.begin(), m_energyLevels.end(), fitsCurrentLevel);
+    return std::find_if(m_prototype->energyLevels.begin(), m_prototype->energyLevels.end(), fitsCurrentLevel);
 }
 
 void Actor::moveTo(QPoint destination)
 {
-    m_position = destination;
-    emit positionChanged(m_position);
+    const auto from = position();
+    m_store->setPosition(m_index, destination);
+    backend()->relocate(this, from, destination);
+    notify(Change::Position);
 }
 
 void Actor::tryMoveTo(QPoint destination)
 {
-    if (backend()->canMoveTo(this, destination))
-        moveTo(destination);
+    backend()->performMove(this, destination);
 }
 
 void Actor::moveLeft()
@@ -140,9 +264,11 @@ void Actor::moveRight()
 
 void Actor::respawn()
 {
-    m_position = m_origin;
-    setEnergy(m_maximumEnergy);
-    emit positionChanged(m_position);
+    const auto from = position();
+    m_store->setPosition(m_index, m_origin);
+    backend()->relocate(this, from, m_origin);
+    setEnergy(m_prototype->maximumEnergy);
+    notify(Change::Position);
 }
 
 int Actor::attack(Actor */*opponent*/)
@@ -152,72 +278,102 @@ int Actor::attack(Actor */*opponent*/)
 
 void Actor::stealEnergy(int amount)
 {
-    setEnergy(qMax(m_minimumEnergy, m_energy - amount));
+    setEnergy(qMax(m_prototype->minimumEnergy, energy() - amount));
 }
 
 void Actor::giveEnergy(int amount)
 {
-    setEnergy(qMin(m_maximumEnergy, m_energy + amount));
+    setEnergy(qMin(m_prototype->maximumEnergy, energy() + amount));
 }
 
 void Actor::die()
 {
-    if (m_lives > 0) {
-        --m_lives;
-        emit livesChanged(m_lives);
+    if (const auto lives = this->lives(); lives > 0) {
+        m_store->setLives(m_index, lives - 1);
+        notify(Change::Lives);
     }
 }
 
+Enemy::Enemy(QJsonObject spec, Backend *backend)
+    : Enemy{ActorKind::Enemy, std::move(spec), backend}
+{}
+
+Enemy::Enemy(ActorKind kind, QJsonObject spec, Backend *backend)
+    : Actor{kind, std::move(spec), backend}
+{}
+
 bool Enemy::canAttack(const Actor *opponent) const
 {
-    return dynamic_cast<const Player *>(opponent) != nullptr;
+    return opponent->kind() == ActorKind::Player;
 }
 
 int Enemy::attack(Actor *opponent)
 {
     if (canAttack(opponent)) {
         opponent->stealEnergy(1);
-        return std::rand() % 2; // FIXME: use proper generator from std::random
+        return random().bounded(2);
     }
 
     return 0;
 }
 
-void Enemy::act()
+Actor::Direction Enemy::propose()
 {
-    // FIXME: use proper generator from std::random
-    const auto direction = Direction{std::rand() % 4};
+    // within reach of the flow field enemies follow it downhill,
+    // which leads them around obstacles towards the player
+
+    if (const auto *const pathFinder = backend()->simulation()->pathFinder();
+            pathFinder->distance(position()) != PathFinder::Unreachable)
+        return pathFinder->direction(position(), random());
+
+    const auto direction = Direction{random().bounded(4)};
+    const auto target = backend()->player()->position();
 
     switch (direction) {
     case Direction::Left:
-        if (backend()->player()->x() < x())
-            moveLeft();
-
+        return target.x() < x() ? direction : Direction::None;
+    case Direction::Up:
+        return target.y() < y() ? direction : Direction::None;
+    case Direction::Right:
+        return target.x() > x() ? direction : Direction::None;
+    case Direction::Down:
+        return target.y() > y() ? direction : Direction::None;
+    case Direction::None:
         break;
+    }
 
-    case Direction::Up:
-        if (backend()->player()->y() < y())
-            moveUp();
+    return Direction::None;
+}
 
+void Enemy::perform(Direction direction)
+{
+    switch (direction) {
+    case Direction::Left:
+        moveLeft();
+        break;
+    case Direction::Up:
+        moveUp();
         break;
-
     case Direction::Right:
-        if (backend()->player()->x() > x())
-            moveRight();
-
+        moveRight();
         break;
-
     case Direction::Down:
-        if (backend()->player()->y() > y())
-            moveDown();
-
+        moveDown();
         break;
-
     case Direction::None:
         break;
     }
 }
 
+void Enemy::act()
+{
+    perform(propose());
+}
+
+Tentaklon::Tentaklon(QJsonObject spec, Backend *backend)
+    : Enemy{ActorKind::Tentaklon, std::move(spec), backend}
+{}
+
 bool Tentaklon::canAttack(const Actor *opponent) const
 {
     return Enemy::canAttack(opponent);
@@ -233,19 +389,19 @@ void Tentaklon::buildMoveCard()
     if (!hasMoveCard()) {
         for (auto &moveCard : m_moveCard) {
             if (const auto right = m_builtPosition + QPoint{+1, 0};
-                backend()->canMoveTo(this, right)) {
+                backend()->isPassable(this, right)) {
                 moveCard        = Direction::Right;
                 m_builtPosition = right;
             } else if (const auto left = m_builtPosition + QPoint{-1, 0};
-                       backend()->canMoveTo(this, left)) {
+                       backend()->isPassable(this, left)) {
                 moveCard        = Direction::Left;
                 m_builtPosition = left;
             } else if (const auto upwards = m_builtPosition + QPoint{0, +1};
-                       backend()->canMoveTo(this, upwards)) {
+                       backend()->isPassable(this, upwards)) {
                 moveCard        = Direction::Up;
                 m_builtPosition = upwards;
             } else if (const auto downwards = m_builtPosition + QPoint{0, -1};
-                       backend()->canMoveTo(this, downwards)) {
+                       backend()->isPassable(this, downwards)) {
                 moveCard        = Direction::Down;
                 m_builtPosition = downwards;
             }
@@ -295,14 +451,14 @@ void Tentaklon::act()
 }
 
 Player::Player(QJsonObject spec, Backend *backend)
-    : Actor{std::move(spec), backend}
+    : Actor{ActorKind::Player, std::move(spec), backend}
     , m_inventory{new InventoryModel{this}}
 {}
 
 
 bool Player::canAttack(const Actor *opponent) const
 {
-    return dynamic_cast<const Player *>(opponent) == nullptr;
+    return opponent->kind() != ActorKind::Player;
         // && m_hitEnergy > 0
 }
 
@@ -311,20 +467,18 @@ int Player::attack(Actor *opponent)
     if (canAttack(opponent)) {
         opponent->stealEnergy(1);
 //        m_hitEnergy--;
-        return std::rand() % 2; // FIXME: use proper generator from std::random
+        return random().bounded(2);
     }
 
     return 0;
 }
 
-Item::Item(QJsonObject spec, Backend *backend)
-    : Actor(spec, backend)
-    , m_type{spec["type"].toString()}
-    , m_color{spec["color"].toString()}
+Item::Item(ActorKind kind, QJsonObject spec, Backend *backend)
+    : Actor(kind, std::move(spec), backend)
 {}
 
 Chest::Chest(QJsonObject spec, Backend *backend)
-    : Item{applyDefaults(spec), backend}
+    : Item{ActorKind::Chest, applyDefaults(spec), backend}
     , m_item{backend->item(spec["item"].toString())}
     , m_amount{qMax(spec["amount"].toInt(), 1)}
 {}
@@ -367,7 +521,7 @@ InventoryItem *Chest::item() const
 }
 
 Ladder::Ladder(QJsonObject spec, Backend *backend)
-    : Item{applyDefaults(spec), backend}
+    : Item{ActorKind::Ladder, applyDefaults(spec), backend}
     , m_level{spec["level"].toInt()}
     , m_destination{spec["dx"].toInt(), spec["dy"].toInt()}
 {}
@@ -405,6 +559,10 @@ int Ladder::attack(Actor */*opponent*/)
     return 0;
 }
 
+WitchShop::WitchShop(QJsonObject spec, Backend *backend)
+    : Actor{ActorKind::WitchShop, std::move(spec), backend}
+{}
+
 bool WitchShop::canAttack(const Actor */*opponent*/) const
 {
     return false;
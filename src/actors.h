@@ -1,18 +1,60 @@
 #ifndef GAMEONE_ACTORS_H
 #define GAMEONE_ACTORS_H
 
+#include "actorstore.h"
+#include "animationclock.h"
+#include "random.h"
+
 #include <QColor>
+#include <QJsonObject>
 #include <QObject>
 #include <QPoint>
 #include <QPointer>
 #include <QUrl>
 
+#include <memory>
+
 namespace GameOne {
 
 class Backend;
 class InventoryItem;
 class InventoryModel;
 
+// The immutable part of an actor, shared by all actors of the same type.
+struct ActorPrototype
+{
+    struct EnergyLevel
+    {
+        qreal minimumEnergy;
+        QUrl imageSource;   // falls back to the prototype's image
+        int imageCount;     // falls back to the prototype's image count
+        QList<QUrl> frames;
+    };
+
+    explicit ActorPrototype(const QJsonObject &spec, const Backend &backend);
+
+    // whether the prototype fields of an actor specification are those this prototype was built from
+    bool matches(const QJsonObject &spec) const;
+
+    QList<QUrl> imageUrls() const;
+
+    QString name;
+    QString type;
+    QColor color;
+
+    QList<EnergyLevel> energyLevels; // sorted by descending energy
+    int minimumEnergy;
+    int maximumEnergy;
+    int maximumLives;
+
+    QUrl imageSource;
+    int imageCount;
+    QList<QUrl> frames;
+    int rotationSteps;
+
+    QJsonObject fields; // the prototype fields of the specification
+};
+
 class Actor : public QObject
 {
     Q_OBJECT
@@ -34,20 +76,35 @@ class Actor : public QObject
     Q_PROPERTY(QColor color READ color CONSTANT FINAL)
     Q_PROPERTY(QUrl imageSource READ imageSource NOTIFY imageSourceChanged FINAL)
     Q_PROPERTY(int imageCount READ imageCount NOTIFY imageCountChanged FINAL)
+    Q_PROPERTY(QUrl frameSource READ frameSource NOTIFY frameSourceChanged FINAL)
 
     Q_PROPERTY(int rotationSteps READ rotationSteps CONSTANT FINAL)
+    Q_PROPERTY(int rotationStep READ rotationStep NOTIFY rotationStepChanged FINAL)
 
 public:
     enum class Direction { None = -1, Up, Left, Right, Down };
     Q_ENUM(Direction)
 
-    explicit Actor(QJsonObject spec, Backend *backend);
+    enum class Change {
+        Position = 0x01,
+        Energy = 0x02,
+        ImageSource = 0x04,
+        ImageCount = 0x08,
+        Lives = 0x10,
+        Frame = 0x20,
+        Rotation = 0x40,
+    };
+
+    Q_DECLARE_FLAGS(Changes, Change)
+
+    explicit Actor(ActorKind kind, QJsonObject spec, Backend *backend);
 
     virtual QString type() const = 0;
+    auto kind() const { return m_store->kind(m_index); }
 
-    auto x() const { return m_position.x(); }
-    auto y() const { return m_position.y(); }
-    auto position() const { return m_position; }
+    auto x() const { return position().x(); }
+    auto y() const { return position().y(); }
+    auto position() const { return m_store->position(m_index); }
 
     void setName(const QString &name);
     auto name() const { return m_name; }
@@ -56,14 +113,18 @@ public:
 
     QUrl imageSource() const;
     int imageCount() const;
+    QList<QUrl> imageUrls() const;
 
-    auto rotationSteps() const { return m_rotationSteps; }
+    QUrl frameSource() const;
 
-    auto lives() const { return m_lives; }
-    auto energy() const { return m_energy; }
-    auto minimumEnergy() const { return m_minimumEnergy; }
-    auto maximumEnergy() const { return m_maximumEnergy; }
-    auto isAlive() const { return m_lives > 0 && m_energy > 0; }
+    auto rotationSteps() const { return m_prototype->rotationSteps; }
+    int rotationStep() const;
+
+    auto lives() const { return m_store->lives(m_index); }
+    auto energy() const { return m_store->energy(m_index); }
+    auto minimumEnergy() const { return m_prototype->minimumEnergy; }
+    auto maximumEnergy() const { return m_prototype->maximumEnergy; }
+    auto isAlive() const { return m_store->isAlive(m_index); }
 
     virtual bool energyVisible() const = 0;
     virtual bool canAttack(const Actor *opponent) const = 0;
@@ -76,6 +137,8 @@ public:
     void giveEnergy(int amount);
     void die();
 
+    void flushChanges();
+
 public slots:
     void moveLeft();
     void moveUp();
@@ -93,45 +156,46 @@ signals:
     void maximumEnergyChanged(int maximumEnergy);
     void imageSourceChanged(QUrl imageSource);
     void imageCountChanged(int imageCount);
+    void frameSourceChanged(QUrl frameSource);
+    void rotationStepChanged(int rotationStep);
 
 protected:
-    Backend *backend() const;
+    Backend *backend() const { return m_backend; }
+    const ActorPrototype &prototype() const { return *m_prototype; }
+    Random &random() { return m_random; }
 
 private:
-    struct EnergyLevel {
-        qreal minimumEnergy;
-        QUrl imageSource;
-        int imageCount;
-    };
-
     void setEnergy(int energy);
+    void updateFrames();
+    void notify(Changes changes);
+
+    QList<ActorPrototype::EnergyLevel>::ConstIterator currentEnergyLevel() const;
 
-    static QList<EnergyLevel> makeEnergyLevels(const QJsonArray &array);
-    QList<EnergyLevel>::ConstIterator currentEnergyLevel() const;
+    const std::shared_ptr<const ActorPrototype> m_prototype;
+    Backend *const m_backend;
+    ActorStore *const m_store;
 
     QString m_name;
     QPoint m_origin;
-    QPoint m_position;
-
-    QList<EnergyLevel> m_energyLevels;
-    int m_minimumEnergy;
-    int m_maximumEnergy;
-    int m_energy = 0;
+    const ActorStore::Index m_index;
 
-    int m_maximumLives;
-    int m_lives;
+    QList<QUrl> m_frames;
+    QPointer<FrameCounter> m_frameCounter;
+    QPointer<FrameCounter> m_rotationCounter;
+    QMetaObject::Connection m_frameConnection;
 
-    QUrl m_imageSource;
-    int m_imageCount;
-    int m_rotationSteps;
+    Random m_random;
+    Changes m_pendingChanges;
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(Actor::Changes)
+
 class Enemy : public Actor
 {
     Q_OBJECT
 
 public:
-    using Actor::Actor;
+    explicit Enemy(QJsonObject spec, Backend *backend);
 
     QString type() const override { return "Enemy"; }
     QColor color() const override { return Qt::red; }
@@ -140,7 +204,14 @@ public:
     bool canAttack(const Actor *opponent) const override;
     int attack(Actor *opponent) override;
 
+    // propose() only reads the world and this enemy's own generator,
+    // so it can run concurrently for different enemies
+    Direction propose();
+    void perform(Direction direction);
     void act();
+
+protected:
+    explicit Enemy(ActorKind kind, QJsonObject spec, Backend *backend);
 };
 
 class Tentaklon : public Enemy // Tentaklon is the "Schleimpilz"(look at "Issues/1/0008" for more info)
@@ -148,7 +219,7 @@ class Tentaklon : public Enemy // Tentaklon is the "Schleimpilz"(look at "Issues
     Q_OBJECT
 
 public:
-    using Enemy::Enemy;
+    explicit Tentaklon(QJsonObject spec, Backend *backend);
 
     QString type() const override { return "Tentaklon"; }
     QColor color() const override { return Qt::red;}
@@ -230,14 +301,10 @@ class Item : public Actor
     Q_OBJECT
 
 public:
-    explicit Item(QJsonObject spec, Backend *backend);
-
-    QString type() const override { return m_type; }
-    QColor color() const override { return m_color; }
+    explicit Item(ActorKind kind, QJsonObject spec, Backend *backend);
 
-private:
-    QString m_type;
-    QColor m_color;
+    QString type() const override { return prototype().type; }
+    QColor color() const override { return prototype().color; }
 };
 
 class Chest : public Item
@@ -297,7 +364,7 @@ class WitchShop : public Actor // ist für Sean, er will einen Laden wo man Elex
     Q_OBJECT
 
 public:
-    using Actor::Actor;
+    explicit WitchShop(QJsonObject spec, Backend *backend);
 
     bool energyVisible() const override { return false; };
     bool canAttack(const Actor *opponent) const override;
@@ -0,0 +1,33 @@
+#include "actorstore.h"
+
+namespace GameOne {
+
+ActorStore::Index ActorStore::append(ActorKind kind, QPoint position, int lives)
+{
+    const auto index = m_kinds.size();
+
+    m_kinds.append(kind);
+    m_positions.append(position);
+    m_energies.append(0);
+    m_lives.append(lives);
+
+    return index;
+}
+
+void ActorStore::reserve(qsizetype count)
+{
+    m_kinds.reserve(count);
+    m_positions.reserve(count);
+    m_energies.reserve(count);
+    m_lives.reserve(count);
+}
+
+void ActorStore::clear()
+{
+    m_kinds.clear();
+    m_positions.clear();
+    m_energies.clear();
+    m_lives.clear();
+}
+
+} // namespace GameOne
@@ -0,0 +1,59 @@
+#ifndef GAMEONE_ACTORSTORE_H
+#define GAMEONE_ACTORSTORE_H
+
+#include <QList>
+#include <QPoint>
+
+namespace GameOne {
+
+// The concrete kind of an actor, so that game rules can dispatch
+// on a plain value instead of querying the class hierarchy.
+enum class ActorKind : quint8 {
+    Player,
+    Enemy,
+    Tentaklon,
+    Chest,
+    Ladder,
+    WitchShop,
+};
+
+// The mutable simulation state of all actors in the current level, stored as parallel
+// arrays indexed by the actor's slot. The Actor objects exposed to QML only keep their
+// slot and read their state from here.
+//
+// This is a first step only: the simulation and the occupancy index still go through
+// Actor pointers, and an Actor is created for every actor, not only for visible ones.
+class ActorStore
+{
+public:
+    using Index = qsizetype;
+
+    Index append(ActorKind kind, QPoint position, int lives);
+    void reserve(qsizetype count);
+    void clear();
+
+    qsizetype size() const { return m_kinds.size(); }
+
+    ActorKind kind(Index index) const { return m_kinds[index]; }
+
+    QPoint position(Index index) const { return m_positions[index]; }
+    void setPosition(Index index, QPoint position) { m_positions[index] = position; }
+
+    int energy(Index index) const { return m_energies[index]; }
+    void setEnergy(Index index, int energy) { m_energies[index] = energy; }
+
+    int lives(Index index) const { return m_lives[index]; }
+    void setLives(Index index, int lives) { m_lives[index] = lives; }
+
+    bool isAlive(Index index) const { return m_lives[index] > 0 && m_energies[index] > 0; }
+
+private:
+    QList<ActorKind> m_kinds;
+    QList<QPoint> m_positions;
+    QList<int> m_energies;
+    QList<int> m_lives;
+};
+
+} // namespace GameOne
+
+#endif // GAMEONE_ACTORSTORE_H
@@ -0,0 +1,61 @@
+#include "animationclock.h"
+
+namespace GameOne {
+
+namespace {
+
+int frameAt(qint64 ticks, int frameCount, int offset)
+{
+    return static_cast<int>(((ticks + offset) % frameCount + frameCount) % frameCount);
+}
+
+} // namespace
+
+FrameCounter::FrameCounter(int frameCount, int offset, QObject *parent)
+    : QObject{parent}
+    , m_frameCount{frameCount}
+    , m_offset{offset}
+{}
+
+void FrameCounter::setTicks(qint64 ticks)
+{
+    if (const auto frame = frameAt(ticks, m_frameCount, m_offset); std::exchange(m_frame, frame) != frame)
+        emit frameChanged(m_frame);
+}
+
+void AnimationClock::setTicks(qint64 ticks)
+{
+    if (std::exchange(m_ticks, ticks) == ticks)
+        return;
+
+    // one update per distinct animation, no matter how many objects show it
+    for (auto *const counter : std::as_const(m_counters))
+        counter->setTicks(m_ticks);
+
+    emit ticksChanged(m_ticks);
+}
+
+FrameCounter *AnimationClock::counter(int frameCount, int offset)
+{
+    if (frameCount <= 1)
+        return nullptr;
+
+    const auto key = std::pair{frameCount, frameAt(offset, frameCount, 0)};
+    auto &counter = m_counters[key];
+
+    if (counter == nullptr) {
+        counter = new FrameCounter{key.first, key.second, this};
+        counter->setTicks(m_ticks);
+    }
+
+    return counter;
+}
+
+int AnimationClock::frame(int frameCount, int offset) const
+{
+    return frameCount > 1 ? frameAt(m_ticks, frameCount, offset) : 0;
+}
+
+} // namespace GameOne
+
+#include "moc_animationclock.cpp"
@@ -0,0 +1,65 @@
+#ifndef GAMEONE_ANIMATIONCLOCK_H
+#define GAMEONE_ANIMATIONCLOCK_H
+
+#include <QHash>
+#include <QObject>
+
+namespace GameOne {
+
+// Counts the frames of all animations that share the same number of frames and the same offset.
+class FrameCounter : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int frame READ frame NOTIFY frameChanged FINAL)
+    Q_PROPERTY(int frameCount READ frameCount CONSTANT FINAL)
+    Q_PROPERTY(int offset READ offset CONSTANT FINAL)
+
+public:
+    int frame() const { return m_frame; }
+    int frameCount() const { return m_frameCount; }
+    int offset() const { return m_offset; }
+
+signals:
+    void frameChanged(int frame);
+
+private:
+    friend class AnimationClock;
+
+    explicit FrameCounter(int frameCount, int offset, QObject *parent);
+
+    void setTicks(qint64 ticks);
+
+    const int m_frameCount;
+    const int m_offset;
+    int m_frame = 0;
+};
+
+// Drives all animations from one tick counter. Instead of observing every tick,
+// animated objects subscribe to the FrameCounter of their animation, and static
+// images subscribe to nothing at all.
+class AnimationClock : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(qint64 ticks READ ticks NOTIFY ticksChanged FINAL)
+
+public:
+    using QObject::QObject;
+
+    qint64 ticks() const { return m_ticks; }
+    void setTicks(qint64 ticks);
+
+    // returns nullptr for static images, which never change their frame
+    Q_INVOKABLE GameOne::FrameCounter *counter(int frameCount, int offset = 0);
+    int frame(int frameCount, int offset = 0) const;
+
+signals:
+    void ticksChanged(qint64 ticks);
+
+private:
+    QHash<std::pair<int, int>, FrameCounter *> m_counters;
+    qint64 m_ticks = 0;
+};
+
+} // namespace GameOne
+
+#endif // GAMEONE_ANIMATIONCLOCK_H
@@ -5,10 +5,12 @@
 #include "inventorymodel.h"
 #include "levelmodel.h"
 #include "mapmodel.h"
+#include "mapview.h"
 
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
+#include <QtMath>
 
 static void initResources()
 {
@@ -19,6 +21,12 @@ static void initResources()
 
 namespace GameOne {
 
+namespace {
+
+constexpr auto DefaultCellSize = 60;
+
+} // namespace
+
 int Application::run(const QUrl &qmlRoot)
 {
     if (qmlRoot.isEmpty())
@@ -31,17 +39,43 @@ int Application::run(const QUrl &qmlRoot)
     qmlRegisterUncreatableType<Chest>("GameOne", 1, 0, "Chest", "Managed and created by Backend");
     qmlRegisterUncreatableType<Enemy>("GameOne", 1, 0, "Enemy", "Managed and created by Backend");
     qmlRegisterUncreatableType<Ladder>("GameOne", 1, 0, "Ladder", "Managed and created by Backend");
+    qmlRegisterUncreatableType<AnimationClock>("GameOne", 1, 0, "AnimationClock", "Managed and created by Backend");
+    qmlRegisterUncreatableType<FrameCounter>("GameOne", 1, 0, "FrameCounter", "Managed and created by AnimationClock");
 
     qmlRegisterType<InventoryModel>("GameOne", 1, 0, "InventoryModel");
     qmlRegisterType<LevelModel>("GameOne", 1, 0, "LevelModel");
     qmlRegisterType<MapModel>("GameOne", 1, 0, "MapModel");
+    qmlRegisterType<MapView>("GameOne", 1, 0, "MapView");
 
     auto *const backend = new Backend{this};
     qmlRegisterSingletonInstance<Backend>("GameOne", 1, 0, "Backend", backend);
-    backend->load(arguments().count() > 1 ? arguments().at(1) : Backend::levelFileName(1));
 
     QQmlApplicationEngine qml;
-    qml.addImageProvider("assets", new ImageProvider);
+
+    // GAMEONE_IMAGE_CACHE_MB limits the memory used for rendered assets,
+    // GAMEONE_DISK_CACHE_MB the disk space used to keep them across sessions
+    const auto byteBudget = [](const char *variableName, qint64 defaultBudget) {
+        const auto megabytes = qEnvironmentVariableIntValue(variableName);
+        return megabytes > 0 ? qint64{megabytes} * 1024 * 1024 : defaultBudget;
+    };
+
+    auto *const imageProvider = new ImageProvider{
+        byteBudget("GAMEONE_IMAGE_CACHE_MB", ImageCache::DefaultByteBudget),
+        DiskImageCache::defaultPath(),
+        byteBudget("GAMEONE_DISK_CACHE_MB", DiskImageCache::DefaultByteBudget),
+    };
+    qml.addImageProvider("assets", imageProvider);
+
+    // render the assets of each level in the background while it gets loaded,
+    // so that the first frame doesn't wait for them; until the map view tells
+    // its size the default size of GameGround's cells is assumed
+    connect(backend, &Backend::actorsChanged, imageProvider, [this, backend, imageProvider] {
+        const auto cellSize = qCeil(DefaultCellSize * devicePixelRatio());
+        imageProvider->prefetch(backend->imageUrls(), {cellSize, cellSize});
+    });
+
+    backend->load(arguments().count() > 1 ? arguments().at(1) : Backend::levelFileName(1));
+
     qml.load(qmlRoot);
 
     if (qml.rootObjects().isEmpty())
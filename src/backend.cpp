@@ -1,13 +1,17 @@
 #include "backend.h"
 #include "inventorymodel.h"
+#include "levelblob.h"
 #include "mapmodel.h"
 
 #include <QDir>
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QLoggingCategory>
+#include <QRandomGenerator>
 #include <QTimer>
+#include <QtConcurrentRun>
 
+using namespace Qt::StringLiterals;
 using namespace std::chrono_literals;
 
 namespace GameOne {
@@ -48,6 +52,8 @@ Backend::Backend(QObject *parent)
     : QObject{parent}
     , m_actionTimer{new QTimer{this}}
     , m_ticksTimer{new QTimer{this}}
+    , m_animationClock{new AnimationClock{this}}
+    , m_random{QRandomGenerator::global()->generate64()}
     , m_map{new MapModel{this}}
 {
     connect(m_actionTimer, &QTimer::timeout, this, &Backend::onActionTimeout);
@@ -59,9 +65,19 @@ Backend::Backend(QObject *parent)
     connect(m_map, &MapModel::columnsChanged, this, &Backend::columnsChanged);
     connect(m_map, &MapModel::rowsChanged, this, &Backend::rowsChanged);
 
+    // the flow field must follow walkability changes of the map
+    connect(m_map, &MapModel::dataChanged, this, [this] { m_simulation.pathFinder()->invalidate(); });
+    connect(m_map, &MapModel::modelReset, this, [this] { m_simulation.pathFinder()->invalidate(); });
+
+    m_prototypes.compile();
     loadItemTypes();
 }
 
+Backend::~Backend()
+{
+    m_preloadPool.waitForDone();
+}
+
 int Backend::columns() const
 {
     return m_map->columns();
@@ -98,7 +114,7 @@ InventoryItem *Backend::item(const QString &id) const
     return m_items.value(id);
 }
 
-bool Backend::load(QString fileName, std::optional<QPoint> playerPosition)
+bool Backend::load(QString fileName, std::optional<QPoint> playerPosition, std::optional<quint64> seed)
 {
     qInfo() << "loading" << fileName;
 
@@ -107,24 +123,38 @@ bool Backend::load(QString fileName, std::optional<QPoint> playerPosition)
     fileName = dataFileName(fileName);
 
     if (fileName.endsWith(".json")) {
-        const auto &level = readJson(fileName);
+        auto prepared = std::optional<PreparedLevel>{};
 
-        if (!level.isObject())
-            return false;
+        // levels reachable from the previous level have been prepared in the background;
+        // waiting for an unfinished preload still is cheaper than starting over
 
-        const auto mapData = level["map"].toObject();
-        const auto mapFileName = mapData["filename"].toString();
+        if (const auto it = m_preloads.constFind(fileName); it != m_preloads.cend()) {
+            prepared = it->result();
+            m_preloads.erase(it);
+        }
 
-        if (!m_map->load(mapFileName, static_cast<MapModel::Format>(mapData["format"].toInt())))
+        if (!prepared)
+            prepared = prepareLevel(fileName);
+        if (!prepared)
             return false;
 
+        const auto level = std::move(prepared->level);
+        m_map->apply(std::move(prepared->cells));
+
+        const auto mapFileName = level.value("map").toObject().value("filename").toString();
+
         m_levelFileName = fileName;
-        m_levelName = level["levelName"].toString();
+        m_levelName = level.value("levelName").toString();
 
         if (m_levelName.isEmpty())
             m_levelName = QFileInfo{fileName}.baseName();
 
-        loadItems(level.object(), playerPosition);
+        // without explicit seed the next level continues the current session's sequence,
+        // so that a whole session can be replayed from its initial seed
+        m_seed = seed.value_or(m_random());
+        m_random = Random{m_seed};
+
+        loadItems(level, playerPosition);
         validateActors(fileName, mapFileName);
 
         connect(m_player.get(), &Player::positionChanged, this, [this] { m_actionTimer->start(); });
@@ -138,6 +168,8 @@ bool Backend::load(QString fileName, std::optional<QPoint> playerPosition)
         emit columnsChanged(columns());
         emit rowsChanged(rows());
 
+        preloadAdjacentLevels();
+
         return true;
     }
 
@@ -150,16 +182,22 @@ bool Backend::load(QString fileName, std::optional<QPoint> playerPosition)
 
 void Backend::loadItems(const QJsonObject &level, const std::optional<QPoint> &playerPosition)
 {
+    m_occupants.clear();
+    m_dirtyActors.clear();
     m_actors.clear();
     m_chests.clear();
     m_ladders.clear();
     m_enemies.clear();
+    m_player.reset();
+    m_actorStore.clear();
 
     const auto chests = level["chests"].toArray();
     const auto ladders = level["ladders"].toArray();
     const auto enemies = level["enemies"].toArray();
     const auto tentaklons = level["tentaklons"].toArray();
 
+    m_actorStore.reserve(chests.size() + ladders.size() + enemies.size() + tentaklons.size() + 1);
+
     for (const auto &value: chests)
         m_chests += std::make_shared<Chest>(resolve(value.toObject()), this);
     for (const auto &value: ladders)
@@ -180,6 +218,61 @@ void Backend::loadItems(const QJsonObject &level, const std::optional<QPoint> &p
     std::transform(m_chests.begin(), m_chests.end(), std::back_inserter(m_actors), toRawPointer);
     std::transform(m_enemies.begin(), m_enemies.end(), std::back_inserter(m_actors), toRawPointer);
     m_actors += m_player.get();
+
+    m_simulation.reset(m_map, m_player.get(), enemies());
+}
+
+std::optional<Backend::PreparedLevel> Backend::prepareLevel(const QString &fileName) const
+{
+    // only reads files and the map's immutable tile types, so that it can run on any thread
+
+    if (LevelBlob blob; blob.open(LevelBlob::fileNameFor(fileName)) && blob.isCurrent()) {
+        if (auto cells = m_map->parse(blob))
+            return PreparedLevel{blob.level(), std::move(*cells)};
+    }
+
+    const auto &document = readJson(fileName);
+
+    if (!document.isObject())
+        return {};
+
+    auto level = document.object();
+
+    const auto mapData = level.value("map").toObject();
+    const auto format = static_cast<MapModel::Format>(mapData["format"].toInt());
+
+    if (auto cells = m_map->parse(mapData["filename"].toString(), format))
+        return PreparedLevel{std::move(level), std::move(*cells)};
+
+    return {};
+}
+
+void Backend::preloadAdjacentLevels()
+{
+    // preloads of levels that are no longer reachable are dropped,
+    // those that still are reachable continue from the previous level
+
+    auto preloads = decltype(m_preloads){};
+
+    for (const auto &ladder : std::as_const(m_ladders)) {
+        if (ladder->level() < Ladder::LIMBO_LEVEL)
+            continue;
+
+        const auto fileName = dataFileName(levelFileName(ladder->level()));
+
+        if (preloads.contains(fileName))
+            continue;
+
+        if (const auto it = m_preloads.constFind(fileName); it != m_preloads.cend()) {
+            preloads.insert(fileName, *it);
+        } else {
+            preloads.insert(fileName, QtConcurrent::run(&m_preloadPool, [this, fileName] {
+                return prepareLevel(fileName);
+            }));
+        }
+    }
+
+    m_preloads = std::move(preloads);
 }
 
 void Backend::respawn()
@@ -190,38 +283,96 @@ void Backend::respawn()
     m_actionTimer->stop();
 }
 
-bool Backend::canMoveTo(Actor *actor, QPoint destination) const
+qint64 Backend::step(qint64 count)
+{
+    beginBatch();
+    const auto ticks = m_simulation.step(count);
+    endBatch();
+
+    return ticks;
+}
+
+void Backend::beginBatch()
+{
+    ++m_batchDepth;
+}
+
+void Backend::endBatch()
+{
+    Q_ASSERT(m_batchDepth > 0);
+
+    if (--m_batchDepth > 0 || m_dirtyActors.isEmpty())
+        return;
+
+    const auto dirtyActors = std::exchange(m_dirtyActors, {});
+
+    for (auto *const actor : dirtyActors)
+        actor->flushChanges();
+
+    emit actorsUpdated(dirtyActors);
+}
+
+void Backend::markDirty(Actor *actor)
+{
+    m_dirtyActors.append(actor);
+}
+
+Backend::MoveProbe Backend::probeMove(const Actor *actor, QPoint destination) const
+{
+    if (!actor->isAlive() || !m_map->isWalkable(destination))
+        return {};
+
+    if (auto *const opponent = occupantAt(destination, actor)) {
+        if (opponent->energy() == opponent->minimumEnergy())
+            return {MoveOutcome::Move, opponent};
+        if (actor->canAttack(opponent))
+            return {MoveOutcome::Attack, opponent};
+
+        return {MoveOutcome::Blocked, opponent};
+    }
+
+    return {MoveOutcome::Move};
+}
+
+bool Backend::isPassable(const Actor *actor, QPoint destination) const
+{
+    return probeMove(actor, destination).outcome == MoveOutcome::Move;
+}
+
+void Backend::performMove(Actor *actor, QPoint destination)
 {
     if (actor == m_player.get())
         m_actionTimer->start();
-    if (!actor->isAlive())
-        return false;
-
-    if (destination.x() < 0 || destination.x() >= columns())
-        return false;
-    if (destination.y() < 0 || destination.y() >= rows())
-        return false;
-    if (!m_map->dataByPoint(destination, MapModel::WalkableRole).toBool())
-        return false;
-
-    for (const auto &opponentList = actors(); const auto &opponent : opponentList) {
-        if (opponent == actor)
-            continue;
-        if (!opponent->isAlive())
-            continue;
 
-        if (destination == opponent->position()) {
-            if (opponent->energy() == opponent->minimumEnergy())
-                return true;
+    switch (const auto probe = probeMove(actor, destination); probe.outcome) {
+    case MoveOutcome::Move:
+        actor->moveTo(destination);
+        break;
 
-            if (actor->canAttack(opponent))
-                opponent->giveBonus(actor, actor->attack(opponent));
+    case MoveOutcome::Attack:
+        // bonuses may load another level, which destroys both actors
+        probe.opponent->giveBonus(actor, actor->attack(probe.opponent));
+        break;
 
-            return false;
-        }
+    case MoveOutcome::Blocked:
+        break;
     }
+}
 
-    return true;
+Actor *Backend::occupantAt(QPoint position, const Actor *ignored) const
+{
+    for (auto [it, end] = m_occupants.equal_range(position); it != end; ++it) {
+        if (*it != ignored && (*it)->isAlive())
+            return *it;
+    }
+
+    return nullptr;
+}
+
+void Backend::relocate(Actor *actor, QPoint from, QPoint to)
+{
+    m_occupants.remove(from, actor);
+    m_occupants.insert(to, actor);
 }
 
 QDir Backend::dataDir()
@@ -249,26 +400,89 @@ QUrl Backend::imageUrl(const QUrl &imageUrl)
 
 QUrl Backend::imageUrl(QUrl imageUrl, int imageCount, qint64 tick)
 {
+    // Animated images keep their "(t)" placeholders and just tell the current frame.
+    // This way the image provider can render all frames of an animation in one pass.
+
     if (imageCount > 1) {
-        static const auto pattern = QRegularExpression{R"(\(t([+-]\d+)?\))"};
-        const auto inputQueryString = imageUrl.query();
+        const auto frame = (tick % imageCount + imageCount) % imageCount;
+        auto query = imageUrl.query();
 
-        auto start = qsizetype{0};
-        QString outputQueryString;
+        if (!query.isEmpty())
+            query += u'&';
 
-        for (auto it = pattern.globalMatch(inputQueryString); it.hasNext(); ) {
-            const auto match = it.next();
+        query += "frame="_L1 + QString::number(frame) + "&frames="_L1 + QString::number(imageCount);
+        imageUrl.setQuery(query);
+    }
 
-            outputQueryString += inputQueryString.mid(start, match.capturedStart() - start);
-            outputQueryString += QString::number((tick + match.captured(1).toInt()) % imageCount);
-            start = match.capturedEnd();
-        }
+    return imageUrl;
+}
+
+QList<QUrl> Backend::frameTable(const QUrl &imageSource, int imageCount) const
+{
+    // the URLs of all frames are built once per image, so that animating is an index lookup
+
+    if (imageSource.isEmpty())
+        return {};
+
+    const auto key = std::pair{imageSource, qMax(imageCount, 1)};
 
-        outputQueryString += inputQueryString.mid(start);
-        imageUrl.setQuery(outputQueryString);
+    if (const auto it = m_frameTables.constFind(key); it != m_frameTables.cend())
+        return *it;
+
+    QList<QUrl> frames;
+    frames.reserve(key.second);
+
+    for (auto frame = 0; frame < key.second; ++frame)
+        frames.append(imageUrl(imageSource, key.second, frame));
+
+    return *m_frameTables.insert(key, frames);
+}
+
+std::shared_ptr<const ActorPrototype> Backend::prototype(const QJsonObject &spec) const
+{
+    // actors of the same type share their prototype, only instance fields like the position differ;
+    // prototypes are looked up by name, and only those of that name are compared field by field
+
+    const auto name = spec["name"].toString();
+
+    for (auto it = m_actorPrototypes.constFind(name); it != m_actorPrototypes.cend() && it.key() == name; ++it) {
+        if ((*it)->matches(spec))
+            return *it;
     }
 
-    return imageUrl;
+    auto prototype = std::make_shared<const ActorPrototype>(spec, *this);
+    m_actorPrototypes.insert(name, prototype);
+    return prototype;
+}
+
+QList<QUrl> Backend::imageUrls() const
+{
+    // all images the current level might show: its tiles, all enemy types, and its actors
+    QList<QUrl> urls;
+
+    const auto append = [&urls](const QUrl &imageSource, int imageCount) {
+        if (const auto url = imageUrl(imageSource, imageCount, 0); !url.isEmpty() && !urls.contains(url))
+            urls.append(url);
+    };
+
+    for (auto i = qsizetype{0}; i < m_map->tileTypeCount(); ++i) {
+        const auto &type = m_map->tileType(static_cast<MapModel::TypeIndex>(i));
+        append(type.imageSource, type.imageCount);
+    }
+
+    const auto enemyTypes = resolve(QUrl{"enemies.json"});
+
+    for (auto it = enemyTypes.begin(); it != enemyTypes.end(); ++it) {
+        for (const auto &url : prototype(resolve(it.value().toObject()))->imageUrls())
+            append(url, 0);
+    }
+
+    for (const auto *const actor : m_actors) {
+        for (const auto &url : actor->imageUrls())
+            append(url, 0);
+    }
+
+    return urls;
 }
 
 QString Backend::levelFileName(int index)
@@ -301,12 +515,11 @@ void Backend::loadItemTypes()
 
 void Backend::validateActors(const QString &levelFileName, const QString &mapFileName) const
 {
-    QHash<int, QString> actorTypes;
+    QHash<QPoint, QString> actorTypes;
 
     // verify that actors are declared in the map
     for (auto *const actor : m_actors) {
-        const auto mapIndex = m_map->indexByPoint(actor->position());
-        const auto itemType = mapIndex.data(MapModel::ItemTypeRole).toString();
+        const auto &itemType = m_map->itemTypeAt(actor->position()).name;
 
         if (itemType.isEmpty()) {
             qCWarning(lcBackend,
@@ -320,107 +533,57 @@ void Backend::validateActors(const QString &levelFileName, const QString &mapFil
                       qUtf16Printable(actor->type()), qUtf16Printable(actor->name()));
         }
 
-        actorTypes.insert(mapIndex.row(), actor->type());
+        actorTypes.insert(actor->position(), actor->type());
     }
 
     // verify that actors declared in the map also are declared in the JSON
-    for (auto row = 0, rowCount = m_map->rowCount(); row < rowCount; ++row) {
-        const auto mapIndex =  m_map->index(row);
-        const auto isStart = mapIndex.data(MapModel::IsStartRole).toBool();
+    for (auto y = 0, rowCount = m_map->rows(); y < rowCount; ++y) {
+        for (auto x = 0, columnCount = m_map->columns(); x < columnCount; ++x) {
+            const auto position = QPoint{x, y};
 
-        if (!isStart)
-            continue;
+            if (!m_map->isStartAt(position))
+                continue;
 
-        const auto itemType = mapIndex.data(MapModel::ItemTypeRole).toString();
+            const auto &itemType = m_map->itemTypeAt(position).name;
 
-        if (actorTypes[mapIndex.row()] != itemType) {
-            const auto position = mapIndex.data(MapModel::PositionRole).toPoint();
-            m_map->setData(mapIndex, false, MapModel::IsStartRole);
+            if (actorTypes.value(position) != itemType) {
+                m_map->setData(m_map->indexByPoint(position), false, MapModel::IsStartRole);
 
-            qCWarning(lcBackend,
-                      "%ls: Map contains a start position of an actor of type %ls "
-                      "at (%d,%d), but the details are missing in the JSON",
-                      qUtf16Printable(mapFileName), qUtf16Printable(itemType),
-                      position.x(), position.y());
+                qCWarning(lcBackend,
+                          "%ls: Map contains a start position of an actor of type %ls "
+                          "at (%d,%d), but the details are missing in the JSON",
+                          qUtf16Printable(mapFileName), qUtf16Printable(itemType),
+                          position.x(), position.y());
+            }
         }
     }
 }
 
 void Backend::onActionTimeout()
 {
-    for (const auto &enemy : std::as_const(m_enemies))
-        enemy->act();
+    step();
 }
 
 void Backend::onTicksTimeout()
 {
-    emit ticksChanged(ticks());
-}
-
-QJsonDocument Backend::cachedDocument(const QUrl &url) const
-{
-    if (const auto it = m_jsonCache.find(url); it != m_jsonCache.end())
-        return *it;
-
-    if (url.scheme() != "qrc") {
-        qCWarning(lcBackend, "%ls: Unsupported URL", qUtf16Printable(url.toDisplayString()));
-        return {};
-    }
-
-    QFile file{":" + url.path()};
-
-    if (!file.open(QFile::ReadOnly)) {
-        qCWarning(lcBackend, "%ls: %ls", qUtf16Printable(url.toDisplayString()), qUtf16Printable(file.errorString()));
-        return {};
-    }
+    const auto ticks = this->ticks();
 
-    QJsonParseError status;
-    const auto document = QJsonDocument::fromJson(file.readAll(), &status);
+    // animated actors report their new frames batched like all other changes
+    beginBatch();
+    m_animationClock->setTicks(ticks);
+    endBatch();
 
-    if (status.error != QJsonParseError::NoError) {
-        qCWarning(lcBackend, "%ls: %ls", qUtf16Printable(url.toDisplayString()), qUtf16Printable(status.errorString()));
-        return {};
-    }
-
-    return *m_jsonCache.insert(url, document);
+    emit ticksChanged(ticks);
 }
 
 QJsonObject Backend::resolve(QJsonObject object) const
 {
-    if (const auto ref = object.find("$ref"); ref != object.end()) {
-        auto json = resolve(ref->toString());
-        object.erase(ref);
-
-        for (auto it = json.begin(); it != json.end(); ++it) {
-            if (!object.contains(it.key()))
-                object.insert(it.key(), it.value());
-        }
-    }
-
-    return object;
+    return m_prototypes.resolve(std::move(object));
 }
 
 QJsonObject Backend::resolve(QUrl ref) const
 {
-    static const auto s_basicsUrl = QUrl{"qrc:/GameOne/data/basics.json"};
-
-    if (ref.isEmpty())
-        return {};
-
-    if (ref.path().isEmpty()) {
-        ref.setScheme(s_basicsUrl.scheme());
-        ref.setPath(s_basicsUrl.path());
-    } else if (ref.isRelative()) {
-        ref = s_basicsUrl.resolved(ref);
-    }
-
-    const auto path = ref.fragment().split('/', Qt::SkipEmptyParts);
-    auto object = cachedDocument(ref).object();
-
-    for (const auto &component : path)
-        object = resolve(object[component].toObject());
-
-    return object;
+    return m_prototypes.resolve(ref);
 }
 
 } // namespace GameOne
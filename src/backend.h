@@ -2,10 +2,16 @@
 #define GAMEONE_BACKEND_H
 
 #include "actors.h"
+#include "animationclock.h"
+#include "mapmodel.h"
+#include "prototypetable.h"
+#include "simulation.h"
 
 #include <QElapsedTimer>
+#include <QFuture>
 #include <QJsonDocument>
 #include <QMap>
+#include <QThreadPool>
 
 #include <memory>
 
@@ -14,8 +20,6 @@ class QTimer;
 
 namespace GameOne {
 
-class MapModel;
-
 class Backend : public QObject
 {
     Q_OBJECT
@@ -28,9 +32,11 @@ class Backend : public QObject
     Q_PROPERTY(GameOne::Player *player READ player NOTIFY playerChanged FINAL)
     Q_PROPERTY(GameOne::MapModel *map READ map CONSTANT FINAL)
     Q_PROPERTY(qint64 ticks READ ticks NOTIFY ticksChanged FINAL)
+    Q_PROPERTY(GameOne::AnimationClock *animationClock READ animationClock CONSTANT FINAL)
 
 public:
     explicit Backend(QObject *parent = {});
+    ~Backend() override;
 
     auto levelFileName() const { return m_levelFileName; }
     auto levelName() const { return m_levelName; }
@@ -38,18 +44,48 @@ public:
     int rows() const;
 
     qint64 ticks() const;
+    AnimationClock *animationClock() const { return m_animationClock; }
 
     QList<Actor *> actors() const;
     QList<Enemy *> enemies() const;
     Player *player() const { return m_player.get(); }
     MapModel *map() const { return m_map; }
+    const Simulation *simulation() const { return &m_simulation; }
+    ActorStore *actorStore() { return &m_actorStore; }
 
     InventoryItem *item(const QString &id) const;
 
-    Q_INVOKABLE bool load(QString fileName, std::optional<QPoint> playerPosition = {});
+    auto seed() const { return m_seed; }
+    Random makeRandom() { return m_random.split(); }
+
+    Q_INVOKABLE bool load(QString fileName, std::optional<QPoint> playerPosition = {},
+                          std::optional<quint64> seed = {});
     Q_INVOKABLE void respawn();
 
-    bool canMoveTo(Actor *actor, QPoint destination) const;
+    // advances the simulation by count ticks, reporting all actor changes in one batch
+    qint64 step(qint64 count = 1);
+
+    void beginBatch();
+    void endBatch();
+    bool isBatching() const { return m_batchDepth > 0; }
+    void markDirty(Actor *actor);
+
+    enum class MoveOutcome { Blocked, Move, Attack };
+
+    struct MoveProbe
+    {
+        MoveOutcome outcome = MoveOutcome::Blocked;
+        Actor *opponent = nullptr;
+    };
+
+    // queries only read the world, so that AI planning can call them
+    // speculatively and concurrently; performMove() applies the outcome once
+
+    MoveProbe probeMove(const Actor *actor, QPoint destination) const;
+    bool isPassable(const Actor *actor, QPoint destination) const;
+    void performMove(Actor *actor, QPoint destination);
+    Actor *occupantAt(QPoint position, const Actor *ignored = nullptr) const;
+    void relocate(Actor *actor, QPoint from, QPoint to);
 
     static QDir dataDir();
     static QString dataFileName(const QString &fileName);
@@ -58,9 +94,13 @@ public:
     static QUrl imageUrl(const QUrl &imageUrl);
 
     Q_INVOKABLE static QUrl imageUrl(QUrl imageUrl, int imageCount, qint64 tick);
+    QList<QUrl> frameTable(const QUrl &imageSource, int imageCount) const;
+    std::shared_ptr<const ActorPrototype> prototype(const QJsonObject &spec) const;
 
     static QString levelFileName(int index);
 
+    QList<QUrl> imageUrls() const;
+
     QJsonObject resolve(QJsonObject object) const;
     QJsonObject resolve(QUrl ref) const;
 
@@ -76,32 +116,56 @@ signals:
 
     void ticksChanged(qint64 ticks);
 
+    void actorsUpdated(const QList<GameOne::Actor *> &actors);
+
 private:
-    QJsonDocument cachedDocument(const QUrl &url) const;
+    // a level read and parsed ahead of time, ready to be shown
+    struct PreparedLevel
+    {
+        QJsonObject level;
+        MapModel::Cells cells;
+    };
 
     void loadItemTypes();
     void loadItems(const QJsonObject &level, const std::optional<QPoint> &playerPosition);
     void validateActors(const QString &levelFileName, const QString &mapFileName) const;
 
+    std::optional<PreparedLevel> prepareLevel(const QString &fileName) const;
+    void preloadAdjacentLevels();
+
     void onActionTimeout();
     void onTicksTimeout();
 
     QTimer *const m_actionTimer;
     QTimer *const m_ticksTimer;
     QElapsedTimer m_ticks;
+    AnimationClock *const m_animationClock;
 
+    ActorStore m_actorStore;
     QList<Actor *> m_actors;
     QMap<QString, InventoryItem *> m_items;
     QList<std::shared_ptr<Ladder>> m_ladders;
     QList<std::shared_ptr<Chest>> m_chests;
     QList<std::shared_ptr<Enemy>> m_enemies;
     std::unique_ptr<Player> m_player;
+    QMultiHash<QPoint, Actor *> m_occupants;
+    Simulation m_simulation;
+    QList<Actor *> m_dirtyActors;
+    int m_batchDepth = 0;
+
+    quint64 m_seed = 0;
+    Random m_random;
 
     QString m_levelFileName;
     QString m_levelName;
 
-    mutable QHash<QUrl, QJsonDocument> m_jsonCache;
+    mutable PrototypeTable m_prototypes;
+    mutable QMultiHash<QString, std::shared_ptr<const ActorPrototype>> m_actorPrototypes;
+    mutable QHash<std::pair<QUrl, int>, QList<QUrl>> m_frameTables;
     MapModel *const m_map;
+
+    QThreadPool m_preloadPool;
+    QHash<QString, QFuture<std::optional<PreparedLevel>>> m_preloads;
 };
 
 } // namespace GameOne
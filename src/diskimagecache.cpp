@@ -0,0 +1,177 @@
+#include "diskimagecache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+
+using namespace Qt::StringLiterals;
+
+namespace GameOne {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcDiskImageCache, "GameOne.diskimagecache");
+
+enum HeaderField {
+    MagicField,
+    VersionField,
+    WidthField,
+    HeightField,
+    BytesPerLineField,
+    FormatField,
+    HeaderFieldCount,
+};
+
+static_assert(HeaderFieldCount * sizeof(quint32) <= DiskImageCache::HeaderSize);
+
+quint32 field(const uchar *header, HeaderField field)
+{
+    return qFromLittleEndian<quint32>(header + field * sizeof(quint32));
+}
+
+void unmapImage(void *file)
+{
+    delete static_cast<QFile *>(file); // closing the file also unmaps it
+}
+
+} // namespace
+
+DiskImageCache::DiskImageCache(QString path, qint64 byteBudget)
+    : m_path{std::move(path)}
+    , m_byteBudget{byteBudget}
+{
+    if (isEnabled() && !QDir{}.mkpath(m_path)) {
+        qCWarning(lcDiskImageCache, "Could not create %ls, disabling the disk cache", qUtf16Printable(m_path));
+        m_path.clear();
+    }
+
+    if (isEnabled()) {
+        // temporary files of writes that were interrupted, e.g. by a crash
+        for (const auto &fileInfo : QDir{m_path}.entryInfoList({u"*.raster.*"_s}, QDir::Files))
+            QFile::remove(fileInfo.filePath());
+
+        prune(m_byteBudget);
+    }
+}
+
+QImage DiskImageCache::find(QByteArrayView key) const
+{
+    if (!isEnabled())
+        return {};
+
+    auto file = std::make_unique<QFile>(fileName(key));
+
+    if (!file->open(QFile::ReadOnly) || file->size() < HeaderSize)
+        return {};
+
+    const auto *const data = file->map(0, file->size());
+
+    if (data == nullptr)
+        return {};
+
+    const auto width = static_cast<int>(field(data, WidthField));
+    const auto height = static_cast<int>(field(data, HeightField));
+    const auto bytesPerLine = qsizetype{field(data, BytesPerLineField)};
+    const auto format = static_cast<QImage::Format>(field(data, FormatField));
+
+    if (field(data, MagicField) != Magic
+            || field(data, VersionField) != Version
+            || format <= QImage::Format_Invalid || format >= QImage::NImageFormats
+            || width <= 0 || height <= 0
+            || bytesPerLine < width * qsizetype{QImage::toPixelFormat(format).bitsPerPixel()} / 8
+            || file->size() != HeaderSize + bytesPerLine * height) {
+        qCWarning(lcDiskImageCache, "Ignoring corrupted %ls", qUtf16Printable(file->fileName()));
+        return {};
+    }
+
+    // mark the file as recently used for pruning
+    file->setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+    // the image owns the mapping from now on
+    auto *const mapping = file.release();
+    return QImage{data + HeaderSize, width, height, bytesPerLine, format, unmapImage, mapping};
+}
+
+bool DiskImageCache::insert(QByteArrayView key, const QImage &image)
+{
+    if (!isEnabled() || image.isNull())
+        return false;
+
+    auto header = QByteArray{HeaderSize, '\0'};
+    auto *const data = reinterpret_cast<uchar *>(header.data());
+
+    qToLittleEndian(Magic, data + MagicField * sizeof(quint32));
+    qToLittleEndian(Version, data + VersionField * sizeof(quint32));
+    qToLittleEndian(static_cast<quint32>(image.width()), data + WidthField * sizeof(quint32));
+    qToLittleEndian(static_cast<quint32>(image.height()), data + HeightField * sizeof(quint32));
+    qToLittleEndian(static_cast<quint32>(image.bytesPerLine()), data + BytesPerLineField * sizeof(quint32));
+    qToLittleEndian(static_cast<quint32>(image.format()), data + FormatField * sizeof(quint32));
+
+    auto file = QSaveFile{fileName(key)};
+
+    if (!file.open(QFile::WriteOnly)
+            || file.write(header) != header.size()
+            || file.write(reinterpret_cast<const char *>(image.constBits()), image.sizeInBytes()) != image.sizeInBytes()
+            || !file.commit()) {
+        qCWarning(lcDiskImageCache, "Could not write %ls: %ls",
+                  qUtf16Printable(file.fileName()), qUtf16Printable(file.errorString()));
+        return false;
+    }
+
+    const auto lock = QMutexLocker{&m_mutex};
+    m_byteCount += header.size() + image.sizeInBytes();
+
+    // pruning scans the entire directory, so it makes room for a quarter of the budget at once
+    if (m_byteCount > m_byteBudget)
+        prune(m_byteBudget * 3 / 4);
+
+    return true;
+}
+
+QString DiskImageCache::defaultPath()
+{
+    if (const auto path = QStandardPaths::writableLocation(QStandardPaths::CacheLocation); !path.isEmpty())
+        return QDir{path}.filePath(u"images"_s);
+
+    return {};
+}
+
+void DiskImageCache::prune(qint64 byteLimit)
+{
+    // newest first, so that everything after the first file
+    // that exceeds the limit is less recently used
+
+    const auto files = QDir{m_path}.entryInfoList({u"*.raster"_s}, QDir::Files, QDir::Time);
+    auto byteCount = qint64{0};
+    auto removedCount = 0;
+
+    for (const auto &fileInfo : files) {
+        if (removedCount == 0 && byteCount + fileInfo.size() <= byteLimit) {
+            byteCount += fileInfo.size();
+        } else if (QFile::remove(fileInfo.filePath())) {
+            ++removedCount;
+        } else {
+            byteCount += fileInfo.size();
+        }
+    }
+
+    m_byteCount = byteCount;
+
+    if (removedCount > 0) {
+        qCInfo(lcDiskImageCache, "Removed %d least recently used images from %ls",
+               removedCount, qUtf16Printable(m_path));
+    }
+}
+
+QString DiskImageCache::fileName(QByteArrayView key) const
+{
+    const auto hash = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+    return QDir{m_path}.filePath(QString::fromLatin1(hash) + ".raster"_L1);
+}
+
+} // namespace GameOne
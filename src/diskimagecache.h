@@ -0,0 +1,50 @@
+#ifndef GAMEONE_DISKIMAGECACHE_H
+#define GAMEONE_DISKIMAGECACHE_H
+
+#include <QImage>
+#include <QMutex>
+#include <QString>
+
+namespace GameOne {
+
+// Keeps rendered images across sessions. Each image is stored in its own file:
+// a header of little-endian quint32 fields (magic, version, width, height,
+// bytesPerLine, format) padded to HeaderSize, followed by the raw scanlines.
+// Files are memory-mapped, so that loaded images share their pixels with the
+// page cache instead of being copied.
+//
+// The total size of all files is limited by a byte budget. The modification time
+// of a file is refreshed whenever it is found, so that pruning removes the least
+// recently used files first, including those left over by changed assets.
+class DiskImageCache
+{
+public:
+    static constexpr quint32 Magic = 0x49523147; // "G1RI"
+    static constexpr quint32 Version = 1;
+    static constexpr qsizetype HeaderSize = 64;
+    static constexpr qint64 DefaultByteBudget = qint64{256} * 1024 * 1024;
+
+    explicit DiskImageCache(QString path = defaultPath(), qint64 byteBudget = DefaultByteBudget);
+
+    QString path() const { return m_path; }
+    bool isEnabled() const { return !m_path.isEmpty(); }
+    qint64 byteBudget() const { return m_byteBudget; }
+
+    QImage find(QByteArrayView key) const;
+    bool insert(QByteArrayView key, const QImage &image);
+
+    static QString defaultPath();
+
+private:
+    QString fileName(QByteArrayView key) const;
+    void prune(qint64 byteLimit);
+
+    QString m_path;
+    qint64 m_byteBudget;
+    qint64 m_byteCount = 0;
+    QMutex m_mutex;
+};
+
+} // namespace GameOne
+
+#endif // GAMEONE_DISKIMAGECACHE_H
@@ -0,0 +1,122 @@
+#include "imagecache.h"
+
+#include <QLoggingCategory>
+
+namespace GameOne {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcImageCache, "GameOne.imagecache");
+
+} // namespace
+
+ImageCache::ImageCache(qsizetype byteBudget)
+    : m_byteBudget{byteBudget}
+{}
+
+void ImageCache::setByteBudget(qsizetype byteBudget)
+{
+    m_byteBudget = byteBudget;
+
+    for (auto &shard : m_shards) {
+        const auto lock = QMutexLocker{&shard.mutex};
+        evict(shard);
+    }
+}
+
+QImage ImageCache::find(const Key &key)
+{
+    auto &shard = shardFor(key);
+    const auto lock = QMutexLocker{&shard.mutex};
+
+    if (const auto it = shard.index.constFind(key); it != shard.index.cend()) {
+        shard.entries.splice(shard.entries.begin(), shard.entries, *it);
+        ++m_hits;
+        return (*it)->image;
+    }
+
+    ++m_misses;
+    return {};
+}
+
+void ImageCache::insert(const Key &key, const QImage &image)
+{
+    auto &shard = shardFor(key);
+    const auto lock = QMutexLocker{&shard.mutex};
+
+    if (const auto it = shard.index.constFind(key); it != shard.index.cend()) {
+        shard.bytes -= (*it)->bytes;
+        shard.entries.erase(*it);
+    }
+
+    const auto bytes = image.sizeInBytes();
+
+    shard.entries.push_front({key, image, bytes});
+    shard.index.insert(key, shard.entries.begin());
+    shard.bytes += bytes;
+
+    evict(shard);
+}
+
+void ImageCache::pin(const Key &key)
+{
+    auto &shard = shardFor(key);
+    const auto lock = QMutexLocker{&shard.mutex};
+    ++shard.pins[key];
+}
+
+void ImageCache::unpin(const Key &key)
+{
+    auto &shard = shardFor(key);
+    const auto lock = QMutexLocker{&shard.mutex};
+
+    if (const auto it = shard.pins.find(key); it != shard.pins.end() && --*it <= 0) {
+        shard.pins.erase(it);
+        evict(shard);
+    }
+}
+
+ImageCache::Statistics ImageCache::statistics() const
+{
+    auto statistics = Statistics {
+        .hits      = m_hits,
+        .misses    = m_misses,
+        .evictions = m_evictions,
+    };
+
+    for (const auto &shard : m_shards) {
+        const auto lock = QMutexLocker{&shard.mutex};
+        statistics.count += shard.index.size();
+        statistics.bytes += shard.bytes;
+    }
+
+    return statistics;
+}
+
+ImageCache::Shard &ImageCache::shardFor(const Key &key)
+{
+    return m_shards[qHash(key) % ShardCount];
+}
+
+void ImageCache::evict(Shard &shard)
+{
+    const auto budget = m_byteBudget / qsizetype{ShardCount};
+
+    // never evict the most recent entry, it has just been requested
+    for (auto it = shard.entries.end(); shard.bytes > budget && it != shard.entries.begin(); ) {
+        if (--it == shard.entries.begin())
+            break;
+        if (shard.pins.contains(it->key))
+            continue;
+
+        qCDebug(lcImageCache, "Evicting %ls (%dx%d, %lld bytes)", qUtf16Printable(it->key.id),
+                it->key.size.width(), it->key.size.height(), static_cast<long long>(it->bytes));
+
+        shard.bytes -= it->bytes;
+        shard.index.remove(it->key);
+        it = shard.entries.erase(it);
+        ++m_evictions;
+    }
+}
+
+} // namespace GameOne
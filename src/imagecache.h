@@ -0,0 +1,86 @@
+#ifndef GAMEONE_IMAGECACHE_H
+#define GAMEONE_IMAGECACHE_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+
+#include <array>
+#include <atomic>
+#include <list>
+
+namespace GameOne {
+
+// A thread-safe least-recently-used cache of rendered images with a byte budget.
+// Keys are spread over independently locked shards, so that concurrent lookups
+// rarely wait for each other. Pinned keys are never evicted, even if their
+// image is inserted after pinning.
+class ImageCache
+{
+public:
+    static constexpr qsizetype DefaultByteBudget = qsizetype{256} * 1024 * 1024;
+
+    struct Key
+    {
+        QString id;
+        QSize   size;
+
+        friend bool operator==(const Key &, const Key &) = default;
+        friend size_t qHash(const Key &key, size_t seed = 0)
+        { return qHashMulti(seed, key.id, key.size.width(), key.size.height()); }
+    };
+
+    struct Statistics
+    {
+        quint64   hits = 0;
+        quint64   misses = 0;
+        quint64   evictions = 0;
+        qsizetype count = 0;
+        qsizetype bytes = 0;
+    };
+
+    explicit ImageCache(qsizetype byteBudget = DefaultByteBudget);
+
+    qsizetype byteBudget() const { return m_byteBudget; }
+    void setByteBudget(qsizetype byteBudget);
+
+    QImage find(const Key &key);
+    void insert(const Key &key, const QImage &image);
+
+    void pin(const Key &key);
+    void unpin(const Key &key);
+
+    Statistics statistics() const;
+
+private:
+    static constexpr std::size_t ShardCount = 8;
+
+    struct Entry
+    {
+        Key       key;
+        QImage    image;
+        qsizetype bytes;
+    };
+
+    struct Shard
+    {
+        mutable QMutex mutex;
+        std::list<Entry> entries; // most recently used first
+        QHash<Key, std::list<Entry>::iterator> index;
+        QHash<Key, int> pins;
+        qsizetype bytes = 0;
+    };
+
+    Shard &shardFor(const Key &key);
+    void evict(Shard &shard);
+
+    std::array<Shard, ShardCount> m_shards;
+    std::atomic<qsizetype> m_byteBudget;
+    std::atomic<quint64> m_hits = 0;
+    std::atomic<quint64> m_misses = 0;
+    std::atomic<quint64> m_evictions = 0;
+};
+
+} // namespace GameOne
+
+#endif // GAMEONE_IMAGECACHE_H
@@ -1,13 +1,17 @@
 #include "imageprovider.h"
 
+#include <QCryptographicHash>
 #include <QFile>
+#include <QFutureWatcher>
 #include <QImage>
 #include <QLoggingCategory>
+#include <QMutexLocker>
 #include <QPainter>
 #include <QRegularExpression>
 #include <QStringLiteral>
 #include <QSvgRenderer>
 #include <QUrlQuery>
+#include <QtConcurrentRun>
 
 using namespace Qt::StringLiterals;
 
@@ -21,6 +25,7 @@ struct Layer
 {
     QString layerId;
     QString xmlId;
+    QRectF  bounds = {}; // in viewbox coordinates
 };
 
 auto resolveLayers(const QByteArray &data)
@@ -49,6 +54,18 @@ auto resolveLayers(const QByteArray &data)
     return layers;
 }
 
+} // namespace
+
+// A parsed SVG file, shared by all requests for its layers, frames and sizes.
+struct SvgDocument
+{
+    QSvgRenderer renderer;
+    QList<Layer> layers;
+    QMutex       mutex;
+};
+
+namespace {
+
 auto makeRegularExpression(const QStringList &wildcards)
 {
     QStringList expressions;
@@ -109,82 +126,318 @@ void renderLayers(QPainter &painter, QSvgRenderer &svg, const QList<Layer> &laye
         const auto viewBox = svg.viewBoxF().size();
         auto sx = static_cast<qreal>(imageSize.width()) / viewBox.width();
         auto sy = static_cast<qreal>(imageSize.height()) / viewBox.height();
-        const auto bounds = QTransform{}.scale(sx, sy).mapRect(svg.boundsOnElement(layer.xmlId));
+        const auto bounds = QTransform{}.scale(sx, sy).mapRect(layer.bounds);
         svg.render(&painter, layer.xmlId, bounds);
     }
 }
 
-QImage renderImage(const QByteArray &data, const LayerOptions &options, const QSize &requestedSize)
+struct AnimationOptions
 {
-    auto svg = QSvgRenderer{data};
+    static AnimationOptions fromId(const QString &id);
 
-    if (!svg.isValid()) {
-        qCWarning(lcImages, "%ls: Not a valid SVG image: %ls",
-                  qUtf16Printable(options.id),
-                  qUtf16Printable(options.filePath));
+    QString templateId; // the image id without frame selection, still with "(t)" placeholders
+    int frame = 0;
+    int frameCount = 1;
 
-        return {};
-    }
+    bool isAnimated() const { return frameCount > 1; }
+    QString frameId(int frame) const;
+};
 
-    const auto imageSize = requestedSize.isValid() ? requestedSize : svg.defaultSize();
+AnimationOptions AnimationOptions::fromId(const QString &id)
+{
+    auto url = QUrl{id};
+    auto query = QUrlQuery{url.query()};
 
-    if (imageSize.isNull())
-        return {};
+    const auto frameCount = query.queryItemValue(u"frames"_s).toInt();
 
-    auto image = QImage{imageSize, QImage::Format_ARGB32};
-    image.fill(0);
+    if (frameCount <= 1)
+        return {id};
 
-    auto painter = QPainter{};
+    const auto frame = query.queryItemValue(u"frame"_s).toInt();
 
-    if (!painter.begin(&image)) {
-        qCWarning(lcImages, "%ls: Could not start painting", qUtf16Printable(options.id));
-        return {};
+    query.removeAllQueryItems(u"frame"_s);
+    query.removeAllQueryItems(u"frames"_s);
+    url.setQuery(query.query(QUrl::PrettyDecoded));
+
+    return {url.toString(), qBound(0, frame, frameCount - 1), frameCount};
+}
+
+QString AnimationOptions::frameId(int frame) const
+{
+    if (!isAnimated())
+        return templateId;
+
+    static const auto pattern = QRegularExpression{R"(\(t([+-]\d+)?\))"};
+
+    auto start = qsizetype{0};
+    QString output;
+
+    for (auto it = pattern.globalMatch(templateId); it.hasNext(); ) {
+        const auto match = it.next();
+        const auto value = (frame + match.captured(1).toInt()) % frameCount;
+
+        output += templateId.mid(start, match.capturedStart() - start);
+        output += QString::number((value + frameCount) % frameCount);
+        start = match.capturedEnd();
     }
 
+    output += templateId.mid(start);
+    return output;
+}
+
+void paintImage(QPainter &painter, QSvgRenderer &svg, const QList<Layer> &layerList,
+                const LayerOptions &options, const QSize &imageSize)
+{
     if (options.debug)
         qCInfo(lcImages, "%ls: %dx%d", qUtf16Printable(options.id), imageSize.width(), imageSize.height());
 
     if (options.hide.isEmpty() && options.show.isEmpty()) {
-        svg.render(&painter);
+        svg.render(&painter, QRectF{QPointF{}, imageSize});
     } else {
-        renderLayers(painter, svg, resolveLayers(data), options, imageSize);
+        renderLayers(painter, svg, layerList, options, imageSize);
+    }
+}
+
+// Renders all frames of an animation with a single parsed document,
+// stacked vertically into one image.
+QImage renderAnimation(SvgDocument &document, const AnimationOptions &animation,
+                       const QSize &requestedSize)
+{
+    const auto templateOptions = LayerOptions::fromId(animation.templateId);
+    const auto imageSize = requestedSize.isValid() ? requestedSize : document.renderer.defaultSize();
+
+    if (imageSize.isEmpty())
+        return {};
+
+    auto frames = QImage{imageSize.width(), imageSize.height() * animation.frameCount, QImage::Format_ARGB32};
+    frames.fill(0);
+
+    auto painter = QPainter{};
+
+    if (!painter.begin(&frames)) {
+        qCWarning(lcImages, "%ls: Could not start painting", qUtf16Printable(templateOptions.id));
+        return {};
+    }
+
+    // QSvgRenderer is not reentrant, concurrent requests for the same document must take turns
+    const auto lock = QMutexLocker{&document.mutex};
+
+    for (auto frame = 0; frame < animation.frameCount; ++frame) {
+        painter.save();
+        painter.translate(0, frame * imageSize.height());
+        painter.setClipRect(QRect{QPoint{}, imageSize});
+        paintImage(painter, document.renderer, document.layers,
+                   LayerOptions::fromId(animation.frameId(frame)), imageSize);
+        painter.restore();
     }
 
     painter.end();
 
-    return image;
+    return frames;
+}
+
+QImage frameOf(const QImage &frames, const AnimationOptions &animation)
+{
+    if (!animation.isAnimated() || frames.isNull())
+        return frames;
+
+    const auto frameHeight = frames.height() / animation.frameCount;
+    return frames.copy(0, animation.frame * frameHeight, frames.width(), frameHeight);
 }
 
+class ImageResponse : public QQuickImageResponse
+{
+public:
+    ImageResponse(const QFuture<QImage> &frames, const AnimationOptions &animation)
+    {
+        // the response lives in the image loader thread, which runs an event loop
+        connect(&m_watcher, &QFutureWatcher<QImage>::finished, this, [this, animation] {
+            if (m_watcher.future().resultCount() > 0)
+                m_image = frameOf(m_watcher.result(), animation);
+
+            emit finished();
+        });
+
+        m_watcher.setFuture(frames);
+    }
+
+    QQuickTextureFactory *textureFactory() const override
+    {
+        // the default texture factory lets the scene graph pack small images into its shared texture atlas
+        return QQuickTextureFactory::textureFactoryForImage(m_image);
+    }
+
+    QString errorString() const override
+    {
+        return m_image.isNull() ? u"Could not render image"_s : QString{};
+    }
+
+private:
+    QFutureWatcher<QImage> m_watcher;
+    QImage m_image;
+};
+
 } // namespace
 
-QImage ImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+ImageProvider::ImageProvider(qsizetype byteBudget, const QString &diskCachePath, qint64 diskByteBudget)
+    : m_cache{byteBudget}
+    , m_diskCache{diskCachePath, diskByteBudget}
+{
+    m_renderPool.setObjectName(u"GameOne.images"_s);
+}
+
+ImageProvider::~ImageProvider()
 {
-    const auto key = std::make_tuple(id, requestedSize.width(), requestedSize.height());
+    m_renderPool.waitForDone();
+}
+
+QQuickImageResponse *ImageProvider::requestImageResponse(const QString &id, const QSize &requestedSize)
+{
+    const auto animation = AnimationOptions::fromId(id);
+    return new ImageResponse{frames(animation.templateId, animation.frameCount, requestedSize), animation};
+}
+
+QImage ImageProvider::cachedImage(const QString &id, const QSize &requestedSize)
+{
+    const auto animation = AnimationOptions::fromId(id);
+    return frameOf(m_cache.find({animation.templateId, requestedSize}), animation);
+}
+
+QFuture<QImage> ImageProvider::requestFrame(const QString &id, const QSize &requestedSize)
+{
+    const auto animation = AnimationOptions::fromId(id);
+
+    return frames(animation.templateId, animation.frameCount, requestedSize).then([animation](const QImage &frames) {
+        return frameOf(frames, animation);
+    });
+}
+
+void ImageProvider::prefetch(const QList<QUrl> &imageUrls, const QSize &defaultSize)
+{
+    const auto size = m_prefetchSize.isValid() ? m_prefetchSize : defaultSize;
+
+    for (const auto &url : imageUrls) {
+        if (url.isEmpty())
+            continue;
+
+        const auto animation = AnimationOptions::fromId(url.toString(QUrl::RemoveScheme | QUrl::RemoveAuthority).mid(1));
+        frames(animation.templateId, animation.frameCount, size);
+    }
+}
+
+QFuture<QImage> ImageProvider::frames(const QString &templateId, int frameCount, const QSize &requestedSize)
+{
+    const auto key = ImageCache::Key{templateId, requestedSize};
+
+    if (auto image = m_cache.find(key); !image.isNull())
+        return QtFuture::makeReadyValueFuture(std::move(image));
+
+    const auto lock = QMutexLocker{&m_pendingMutex};
+
+    // coalesce with an ongoing rendering of the same image
+    if (const auto it = m_pending.constFind(key); it != m_pending.cend())
+        return *it;
+
+    // a rendering might have finished since the first lookup; renderings
+    // fill the cache before they leave m_pending, so this catches it
+    if (auto image = m_cache.find(key); !image.isNull())
+        return QtFuture::makeReadyValueFuture(std::move(image));
+
+    // for animations the cache holds all frames, so that each document is painted only once
+    auto future = QtConcurrent::run(&m_renderPool, [this, key, frameCount] {
+        const auto filePath = LayerOptions::fromId(key.id).filePath;
+
+        // rendered images from earlier sessions stay valid as long as the asset doesn't change
+        const auto diskKey = contentHash(filePath) + '\n' + key.id.toUtf8() + '\n'
+                + QByteArray::number(frameCount) + '\n'
+                + QByteArray::number(key.size.width()) + 'x' + QByteArray::number(key.size.height());
+
+        auto image = m_diskCache.find(diskKey);
+
+        if (image.isNull()) {
+            if (const auto document = this->document(filePath))
+                image = renderAnimation(*document, {key.id, 0, frameCount}, key.size);
 
-    if (QMutexLocker lock{&m_cacheMutex}; true) {
-        if (const auto it = m_cache.find(key); it != m_cache.end())
+            m_diskCache.insert(diskKey, image);
+        }
+
+        if (!image.isNull())
+            m_cache.insert(key, image);
+
+        const auto lock = QMutexLocker{&m_pendingMutex};
+        m_pending.remove(key);
+
+        return image;
+    });
+
+    m_pending.insert(key, future);
+    return future;
+}
+
+std::shared_ptr<SvgDocument> ImageProvider::document(const QString &filePath)
+{
+    if (QMutexLocker lock{&m_documentsMutex}; true) {
+        if (const auto it = m_documents.find(filePath); it != m_documents.end())
             return *it;
     }
 
-    const auto options = LayerOptions::fromId(id);
-    auto file = QFile{options.filePath};
+    auto file = QFile{filePath};
 
     if (!file.open(QFile::ReadOnly)) {
-        qCWarning(lcImages, "%ls: Could not read %ls: %ls",
-                  qUtf16Printable(id), qUtf16Printable(file.fileName()),
+        qCWarning(lcImages, "Could not read %ls: %ls",
+                  qUtf16Printable(file.fileName()),
                   qUtf16Printable(file.errorString()));
         return {};
     }
 
-    auto image = renderImage(file.readAll(), options, requestedSize);
+    const auto data = file.readAll();
+    auto document = std::make_shared<SvgDocument>();
+
+    if (!document->renderer.load(data)) {
+        qCWarning(lcImages, "Not a valid SVG image: %ls", qUtf16Printable(filePath));
+        return {};
+    }
+
+    // scan the layers and their bounds once, so that later
+    // layer and frame combinations only need to paint
+
+    document->layers = resolveLayers(data);
+
+    for (auto &layer : document->layers)
+        layer.bounds = document->renderer.boundsOnElement(layer.xmlId);
+
+    const auto lock = QMutexLocker{&m_documentsMutex};
+
+    if (const auto it = m_documents.find(filePath); it != m_documents.end())
+        return *it; // another thread was faster
+
+    return *m_documents.insert(filePath, std::move(document));
+}
+
+QByteArray ImageProvider::contentHash(const QString &filePath)
+{
+    if (QMutexLocker lock{&m_documentsMutex}; true) {
+        if (const auto it = m_contentHashes.constFind(filePath); it != m_contentHashes.cend())
+            return *it;
+    }
+
+    auto hash = QCryptographicHash{QCryptographicHash::Sha1};
 
-    if (QMutexLocker lock{&m_cacheMutex}; true)
-        m_cache.insert(key, image);
+    if (auto file = QFile{filePath}; file.open(QFile::ReadOnly))
+        hash.addData(&file);
 
-    if (size != nullptr)
-        *size = image.size();
+    const auto lock = QMutexLocker{&m_documentsMutex};
+    return *m_contentHashes.insert(filePath, hash.result());
+}
 
-    return image;
+void ImageProvider::pin(const QString &id, const QSize &requestedSize)
+{
+    m_cache.pin({AnimationOptions::fromId(id).templateId, requestedSize});
+}
+
+void ImageProvider::unpin(const QString &id, const QSize &requestedSize)
+{
+    m_cache.unpin({AnimationOptions::fromId(id).templateId, requestedSize});
 }
 
 } // namespace GameOne
@@ -1,20 +1,68 @@
 #ifndef GAMEONE_IMAGEPROVIDER_H
 #define GAMEONE_IMAGEPROVIDER_H
 
+#include "diskimagecache.h"
+#include "imagecache.h"
+
+#include <QFuture>
+#include <QHash>
 #include <QMutex>
-#include <QQuickImageProvider>
+#include <QQuickAsyncImageProvider>
+#include <QThreadPool>
+
+#include <memory>
 
 namespace GameOne {
 
-class ImageProvider : public QQuickImageProvider
+struct SvgDocument;
+
+// Renders the SVG assets on a pool of worker threads. Concurrent requests for
+// the same image share one rendering, and prefetch() renders the assets of a
+// level before the scene graph asks for them.
+class ImageProvider : public QQuickAsyncImageProvider
 {
 public:
-    ImageProvider() : QQuickImageProvider{Image} {}
-    QImage requestImage(const QString &id, QSize *size, const QSize& requestedSize) override;
+    explicit ImageProvider(qsizetype byteBudget = ImageCache::DefaultByteBudget,
+                           const QString &diskCachePath = DiskImageCache::defaultPath(),
+                           qint64 diskByteBudget = DiskImageCache::DefaultByteBudget);
+    ~ImageProvider() override;
+
+    QQuickImageResponse *requestImageResponse(const QString &id, const QSize &requestedSize) override;
+
+    // for painting outside of the scene graph's image loading: cachedImage() never blocks
+    // and returns a null image until the rendering, started by requestFrame(), has finished
+    QImage cachedImage(const QString &id, const QSize &requestedSize);
+    QFuture<QImage> requestFrame(const QString &id, const QSize &requestedSize);
+
+    // renders the images at the size the map is currently shown at, as told by setPrefetchSize(),
+    // or at defaultSize until then; both must be called from the GUI thread
+    void prefetch(const QList<QUrl> &imageUrls, const QSize &defaultSize);
+    void setPrefetchSize(const QSize &size) { m_prefetchSize = size; }
+
+    // keeps the image for this id and size in memory, for instance while it is visible
+    void pin(const QString &id, const QSize &requestedSize);
+    void unpin(const QString &id, const QSize &requestedSize);
+
+    ImageCache *cache() { return &m_cache; }
 
 private:
-    QMap<std::tuple<QString, int, int>, QImage> m_cache;
-    QMutex m_cacheMutex;
+    QFuture<QImage> frames(const QString &templateId, int frameCount, const QSize &requestedSize);
+    std::shared_ptr<SvgDocument> document(const QString &filePath);
+    QByteArray contentHash(const QString &filePath);
+
+    QHash<QString, std::shared_ptr<SvgDocument>> m_documents;
+    QHash<QString, QByteArray> m_contentHashes;
+    QMutex m_documentsMutex;
+
+    ImageCache m_cache;
+    DiskImageCache m_diskCache;
+
+    QHash<ImageCache::Key, QFuture<QImage>> m_pending;
+    QMutex m_pendingMutex;
+
+    QSize m_prefetchSize;
+
+    QThreadPool m_renderPool;
 };
 
 } // namespace GameOne
@@ -0,0 +1,284 @@
+#include "levelblob.h"
+
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborStreamReader>
+#include <QCborValue>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QtEndian>
+
+#include <limits>
+
+using namespace Qt::StringLiterals;
+
+namespace GameOne {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcLevelBlob, "GameOne.levelblob");
+
+enum HeaderField {
+    MagicField,
+    VersionField,
+    ColumnsField,
+    RowsField,
+    StringCountField,
+    StringsOffsetField,
+    CellsOffsetField,
+    LevelOffsetField,
+    LevelSizeField,
+    SourcesOffsetField,
+    SourcesSizeField,
+    HeaderFieldCount,
+};
+
+constexpr auto HeaderSize = qsizetype{HeaderFieldCount * sizeof(quint32)};
+
+constexpr qsizetype offsetOf(HeaderField field)
+{
+    return field * qsizetype{sizeof(quint32)};
+}
+
+void appendField(QByteArray &data, quint32 value)
+{
+    const auto littleEndian = qToLittleEndian(value);
+    data.append(reinterpret_cast<const char *>(&littleEndian), sizeof littleEndian);
+}
+
+void setField(QByteArray &data, qsizetype offset, quint32 value)
+{
+    qToLittleEndian(value, data.data() + offset);
+}
+
+QString readString(QCborStreamReader &reader)
+{
+    auto text = QString{};
+    auto chunk = reader.readString();
+
+    for (; chunk.status == QCborStreamReader::Ok; chunk = reader.readString())
+        text += chunk.data;
+
+    if (chunk.status != QCborStreamReader::EndOfString)
+        return {};
+
+    return text;
+}
+
+// the stamp of a source file, as stored in the sources section: [fileName, lastModified, size]
+
+QCborArray sourceStamp(const QDir &sourceDir, const QString &fileName)
+{
+    const auto fileInfo = QFileInfo{sourceDir.filePath(fileName)};
+    return {fileName, fileInfo.lastModified().toMSecsSinceEpoch(), fileInfo.size()};
+}
+
+} // namespace
+
+bool LevelBlob::open(const QString &fileName)
+{
+    m_file.setFileName(fileName);
+
+    if (!m_file.open(QFile::ReadOnly))
+        return false;
+
+    // uncompressed resources and regular files can be mapped directly
+
+    if (const auto *const data = m_file.map(0, m_file.size())) {
+        m_data = {data, m_file.size()};
+    } else {
+        m_buffer = m_file.readAll();
+        m_data = m_buffer;
+    }
+
+    if (m_data.size() < HeaderSize || word(offsetOf(MagicField)) != Magic) {
+        qCWarning(lcLevelBlob, "%ls: Not a compiled level", qUtf16Printable(fileName));
+        m_data = {};
+        return false;
+    }
+
+    if (const auto version = word(offsetOf(VersionField)); version != Version) {
+        qCInfo(lcLevelBlob, "%ls: Ignoring compiled level of version %u", qUtf16Printable(fileName), version);
+        m_data = {};
+        return false;
+    }
+
+    m_columns = static_cast<int>(word(offsetOf(ColumnsField)));
+    m_rows = static_cast<int>(word(offsetOf(RowsField)));
+    m_stringCount = word(offsetOf(StringCountField));
+    m_stringsOffset = word(offsetOf(StringsOffsetField));
+
+    const auto cellCount = quint64{word(offsetOf(ColumnsField))} * word(offsetOf(RowsField));
+
+    if (cellCount > std::numeric_limits<quint32>::max() / 2
+            || m_stringCount > std::numeric_limits<quint32>::max() / 8) {
+        qCWarning(lcLevelBlob, "%ls: Compiled level is corrupted", qUtf16Printable(fileName));
+        m_data = {};
+        return false;
+    }
+
+    const auto cells = section(word(offsetOf(CellsOffsetField)), static_cast<quint32>(cellCount * 2));
+    const auto strings = section(m_stringsOffset, m_stringCount * 2 * quint32{sizeof(quint32)});
+    m_level = section(word(offsetOf(LevelOffsetField)), word(offsetOf(LevelSizeField)));
+    m_sources = section(word(offsetOf(SourcesOffsetField)), word(offsetOf(SourcesSizeField)));
+
+    if (cells.isNull() || strings.isNull() || m_level.isNull() || m_sources.isNull()) {
+        qCWarning(lcLevelBlob, "%ls: Compiled level is truncated", qUtf16Printable(fileName));
+        m_data = {};
+        return false;
+    }
+
+    m_cells = {reinterpret_cast<const quint8 *>(cells.data()), static_cast<std::size_t>(cells.size())};
+    return true;
+}
+
+bool LevelBlob::isCurrent() const
+{
+    if (!isValid())
+        return false;
+
+    const auto sourceDir = QFileInfo{m_file.fileName()}.dir();
+    const auto sources = QCborValue::fromCbor(m_sources.data(), m_sources.size()).toArray();
+
+    if (sources.isEmpty())
+        return false;
+
+    for (const auto &value : sources) {
+        const auto recorded = value.toArray();
+        const auto fileName = recorded.at(0).toString();
+
+        if (sourceStamp(sourceDir, fileName) != recorded) {
+            qCInfo(lcLevelBlob, "%ls: Ignoring compiled level, %ls has changed",
+                   qUtf16Printable(m_file.fileName()), qUtf16Printable(fileName));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QStringList LevelBlob::typeNames() const
+{
+    QStringList names;
+    names.reserve(m_stringCount);
+
+    for (auto i = quint32{0}; i < m_stringCount; ++i) {
+        const auto entry = qsizetype{m_stringsOffset} + i * 2 * qsizetype{sizeof(quint32)};
+        const auto text = section(word(entry), word(entry + qsizetype{sizeof(quint32)}));
+        names.append(QString::fromUtf8(text));
+    }
+
+    return names;
+}
+
+QJsonObject LevelBlob::level() const
+{
+    return QCborValue::fromCbor(m_level.data(), m_level.size()).toMap().toJsonObject();
+}
+
+QString LevelBlob::levelName() const
+{
+    // only walk the top-level keys and skip all other values
+    // undecoded, instead of converting the entire level to JSON
+
+    auto reader = QCborStreamReader{m_level.data(), m_level.size()};
+
+    if (!reader.isMap() || !reader.enterContainer())
+        return {};
+
+    while (reader.hasNext() && reader.lastError() == QCborError::NoError) {
+        if (!reader.isString()) {
+            reader.next();
+        } else if (readString(reader) == "levelName"_L1) {
+            return reader.isString() ? readString(reader) : QString{};
+        }
+
+        reader.next();
+    }
+
+    return {};
+}
+
+QString LevelBlob::fileNameFor(const QString &levelFileName)
+{
+    if (levelFileName.endsWith(".json"))
+        return levelFileName.chopped(5) + ".bin";
+
+    return levelFileName + ".bin";
+}
+
+QByteArray LevelBlob::compile(const QJsonObject &level, const QStringList &typeNames,
+                              int columns, int rows, std::span<const quint8> cells,
+                              const QDir &sourceDir, const QStringList &sourceFileNames)
+{
+    QByteArray data;
+    data.reserve(HeaderSize + static_cast<qsizetype>(cells.size()));
+
+    for (auto i = 0; i < HeaderFieldCount; ++i)
+        appendField(data, 0);
+
+    setField(data, offsetOf(MagicField), Magic);
+    setField(data, offsetOf(VersionField), Version);
+    setField(data, offsetOf(ColumnsField), static_cast<quint32>(columns));
+    setField(data, offsetOf(RowsField), static_cast<quint32>(rows));
+
+    // string table: the directory first, then the UTF-8 data
+
+    QList<QByteArray> strings;
+
+    for (const auto &name : typeNames)
+        strings.append(name.toUtf8());
+
+    setField(data, offsetOf(StringCountField), static_cast<quint32>(strings.size()));
+    setField(data, offsetOf(StringsOffsetField), static_cast<quint32>(data.size()));
+
+    auto stringOffset = static_cast<quint32>(data.size() + strings.size() * 2 * sizeof(quint32));
+
+    for (const auto &text : std::as_const(strings)) {
+        appendField(data, stringOffset);
+        appendField(data, static_cast<quint32>(text.size()));
+        stringOffset += static_cast<quint32>(text.size());
+    }
+
+    for (const auto &text : std::as_const(strings))
+        data.append(text);
+
+    setField(data, offsetOf(CellsOffsetField), static_cast<quint32>(data.size()));
+    data.append(reinterpret_cast<const char *>(cells.data()), static_cast<qsizetype>(cells.size()));
+
+    const auto cbor = QCborValue::fromJsonValue(level).toCbor();
+    setField(data, offsetOf(LevelOffsetField), static_cast<quint32>(data.size()));
+    setField(data, offsetOf(LevelSizeField), static_cast<quint32>(cbor.size()));
+    data.append(cbor);
+
+    QCborArray sources;
+
+    for (const auto &fileName : sourceFileNames)
+        sources.append(sourceStamp(sourceDir, fileName));
+
+    const auto sourcesCbor = QCborValue{sources}.toCbor();
+    setField(data, offsetOf(SourcesOffsetField), static_cast<quint32>(data.size()));
+    setField(data, offsetOf(SourcesSizeField), static_cast<quint32>(sourcesCbor.size()));
+    data.append(sourcesCbor);
+
+    return data;
+}
+
+quint32 LevelBlob::word(qsizetype offset) const
+{
+    if (offset < 0 || offset + qsizetype{sizeof(quint32)} > m_data.size())
+        return 0;
+
+    return qFromLittleEndian<quint32>(m_data.data() + offset);
+}
+
+QByteArrayView LevelBlob::section(quint32 offset, quint32 size) const
+{
+    if (quint64{offset} + size > static_cast<quint64>(m_data.size()))
+        return {};
+
+    return m_data.sliced(offset, size);
+}
+
+} // namespace GameOne
@@ -0,0 +1,67 @@
+#ifndef GAMEONE_LEVELBLOB_H
+#define GAMEONE_LEVELBLOB_H
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QJsonObject>
+#include <QStringList>
+
+#include <span>
+
+namespace GameOne {
+
+// A level precompiled by GameOneLevelCompiler. The header consists of little-endian
+// quint32 fields: magic, version, columns, rows, stringCount, stringsOffset, cellsOffset,
+// levelOffset, levelSize, sourcesOffset, sourcesSize. The string table holds the names of
+// all tile types, each cell is a pair of (tile, item) indices into that table, and the level
+// description with all $ref chains already resolved is stored as CBOR. The sources section
+// records name, modification time and size of every file the level was compiled from, so
+// that isCurrent() can detect a compiled level that is older than its JSON.
+class LevelBlob
+{
+public:
+    static constexpr quint32 Magic = 0x424c3147; // "G1LB"
+    static constexpr quint32 Version = 2;
+
+    LevelBlob() = default;
+    LevelBlob(const LevelBlob &) = delete;
+    LevelBlob &operator=(const LevelBlob &) = delete;
+
+    bool open(const QString &fileName);
+    bool isValid() const { return !m_data.isEmpty(); }
+    bool isCurrent() const;
+
+    int columns() const { return m_columns; }
+    int rows() const { return m_rows; }
+
+    QStringList typeNames() const;
+    std::span<const quint8> cells() const { return m_cells; }
+    QJsonObject level() const;
+    QString levelName() const;
+
+    static QString fileNameFor(const QString &levelFileName);
+    static QByteArray compile(const QJsonObject &level, const QStringList &typeNames,
+                              int columns, int rows, std::span<const quint8> cells,
+                              const QDir &sourceDir, const QStringList &sourceFileNames);
+
+private:
+    quint32 word(qsizetype offset) const;
+    QByteArrayView section(quint32 offset, quint32 size) const;
+
+    QFile m_file;
+    QByteArray m_buffer;
+    QByteArrayView m_data;
+
+    int m_columns = 0;
+    int m_rows = 0;
+    quint32 m_stringCount = 0;
+    quint32 m_stringsOffset = 0;
+    std::span<const quint8> m_cells;
+    QByteArrayView m_level;
+    QByteArrayView m_sources;
+};
+
+} // namespace GameOne
+
+#endif // GAMEONE_LEVELBLOB_H
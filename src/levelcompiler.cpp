@@ -0,0 +1,120 @@
+#include "backend.h"
+#include "levelblob.h"
+#include "mapmodel.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSaveFile>
+
+using namespace GameOne;
+using namespace Qt::StringLiterals;
+
+namespace {
+
+QJsonArray resolveAll(const Backend &backend, const QJsonArray &specs)
+{
+    QJsonArray resolved;
+
+    for (const auto &value : specs)
+        resolved.append(backend.resolve(value.toObject()));
+
+    return resolved;
+}
+
+int compileLevel(const QString &levelFileName, const QString &outputFileName)
+{
+    auto backend = Backend{};
+    auto file = QFile{Backend::dataFileName(levelFileName)};
+
+    if (!file.open(QFile::ReadOnly)) {
+        qCritical("Could not open %ls: %ls", qUtf16Printable(file.fileName()),
+                  qUtf16Printable(file.errorString()));
+        return EXIT_FAILURE;
+    }
+
+    auto status = QJsonParseError{};
+    auto level = QJsonDocument::fromJson(file.readAll(), &status).object();
+
+    if (status.error != QJsonParseError::NoError) {
+        qCritical("Could not read %ls: %ls", qUtf16Printable(file.fileName()),
+                  qUtf16Printable(status.errorString()));
+        return EXIT_FAILURE;
+    }
+
+    const auto mapData = level.value("map").toObject();
+    const auto format = static_cast<MapModel::Format>(mapData["format"].toInt());
+    auto *const map = backend.map();
+
+    if (!map->load(mapData["filename"].toString(), format))
+        return EXIT_FAILURE;
+
+    for (const auto &key : {u"chests"_s, u"ladders"_s, u"enemies"_s, u"tentaklons"_s}) {
+        if (level.contains(key))
+            level.insert(key, resolveAll(backend, level.value(key).toArray()));
+    }
+
+    level.insert("player", backend.resolve(level.value("player").toObject()));
+
+    QStringList typeNames;
+
+    for (auto i = qsizetype{0}; i < map->tileTypeCount(); ++i)
+        typeNames.append(map->tileType(static_cast<MapModel::TypeIndex>(i)).name);
+
+    QList<quint8> cells;
+    cells.reserve(qsizetype{map->columns()} * map->rows() * 2);
+
+    for (auto row = 0; row < map->rows(); ++row) {
+        const auto tileTypes = map->tileTypesInRow(row);
+        const auto itemTypes = map->itemTypesInRow(row);
+
+        for (auto column = std::size_t{0}; column < tileTypes.size(); ++column) {
+            cells.append(tileTypes[column]);
+            cells.append(itemTypes[column]);
+        }
+    }
+
+    // the shared JSON files are recorded too, since $ref chains and tile types resolve into them
+
+    auto sourceFileNames = QStringList{levelFileName, mapData["filename"].toString()};
+
+    for (const auto &fileName : Backend::dataDir().entryList({u"*.json"_s}, QDir::Files)) {
+        if (!fileName.endsWith(".level.json"_L1))
+            sourceFileNames.append(fileName);
+    }
+
+    const auto blob = LevelBlob::compile(level, typeNames, map->columns(), map->rows(),
+                                         {cells.constData(), static_cast<std::size_t>(cells.size())},
+                                         Backend::dataDir(), sourceFileNames);
+
+    QDir{}.mkpath(QFileInfo{outputFileName}.absolutePath());
+    auto output = QSaveFile{outputFileName};
+
+    if (!output.open(QFile::WriteOnly) || output.write(blob) != blob.size() || !output.commit()) {
+        qCritical("Could not write %ls: %ls", qUtf16Printable(outputFileName),
+                  qUtf16Printable(output.errorString()));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Q_INIT_RESOURCE(data);
+
+    QCoreApplication app{argc, argv};
+    const auto arguments = QCoreApplication::arguments();
+
+    if (arguments.size() != 3) {
+        qCritical("Usage: %ls LEVEL.level.json OUTPUT.level.bin", qUtf16Printable(arguments.first()));
+        return EXIT_FAILURE;
+    }
+
+    return compileLevel(arguments[1], arguments[2]);
+}
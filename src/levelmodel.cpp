@@ -1,16 +1,22 @@
 #include "levelmodel.h"
 
 #include "backend.h"
+#include "levelblob.h"
 
+#include <QDateTime>
 #include <QDir>
-
-
-#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QtConcurrentMap>
 
 namespace GameOne {
 
 namespace {
 
+Q_LOGGING_CATEGORY(lcLevelModel, "GameOne.levelmodel");
+
 template<class T>
 std::optional<int> toInt(const T &str)
 {
@@ -23,11 +29,92 @@ std::optional<int> toInt(const T &str)
     return {};
 }
 
+constexpr auto lessByIndexAndName = [](const auto &lhs, const auto &rhs) {
+    return std::tie(lhs.index, lhs.name) < std::tie(rhs.index, rhs.name);
+};
+
+// level names are kept for the entire session, they are only read again
+// when the level file's modification time or size has changed
+
+struct CachedName
+{
+    QDateTime lastModified;
+    qint64 size = -1;
+    QString name;
+};
+
+struct NameCache
+{
+    QMutex mutex;
+    QHash<QString, CachedName> names;
+};
+
+NameCache &nameCache()
+{
+    static NameCache cache;
+    return cache;
+}
+
+std::optional<QString> cachedName(const QFileInfo &fileInfo)
+{
+    auto &cache = nameCache();
+    const auto lock = QMutexLocker{&cache.mutex};
+
+    if (const auto it = cache.names.constFind(fileInfo.filePath());
+            it != cache.names.cend()
+            && it->lastModified == fileInfo.lastModified()
+            && it->size == fileInfo.size())
+        return it->name;
+
+    return {};
+}
+
+void cacheName(const QFileInfo &fileInfo, const QString &name)
+{
+    auto &cache = nameCache();
+    const auto lock = QMutexLocker{&cache.mutex};
+    cache.names.insert(fileInfo.filePath(), {fileInfo.lastModified(), fileInfo.size(), name});
+}
+
+std::optional<QString> readLevelName(const QString &fileName)
+{
+    if (LevelBlob blob; blob.open(LevelBlob::fileNameFor(fileName)) && blob.isCurrent())
+        return blob.levelName();
+
+    auto file = QFile{fileName};
+
+    if (!file.open(QFile::ReadOnly)) {
+        qCWarning(lcLevelModel, "Could not open %ls: %ls",
+                  qUtf16Printable(fileName),
+                  qUtf16Printable(file.errorString()));
+
+        return {};
+    }
+
+    auto status = QJsonParseError{};
+    const auto document = QJsonDocument::fromJson(file.readAll(), &status);
+
+    if (status.error != QJsonParseError::NoError) {
+        qCWarning(lcLevelModel, "Could not read %ls: %ls",
+                  qUtf16Printable(fileName),
+                  qUtf16Printable(status.errorString()));
+
+        return {};
+    }
+
+    return document.object().value("levelName").toString();
+}
+
 } // namespace
 
 LevelModel::LevelModel(QObject *parent)
     : QAbstractListModel{parent}
 {
+    connect(&m_scanner, &QFutureWatcherBase::resultReadyAt, this, [this](int index) {
+        if (auto level = m_scanner.resultAt(index); !level.fileName.isEmpty())
+            insertLevel(std::move(level));
+    });
+
     refresh();
 }
 
@@ -63,7 +150,10 @@ QHash<int, QByteArray> LevelModel::roleNames() const
 
 void LevelModel::refresh()
 {
-    Backend levelReader;
+    m_scanner.cancel();
+    m_scanner.waitForFinished();
+
+    QList<QFileInfo> pending;
 
     beginResetModel();
     m_levels.clear();
@@ -71,18 +161,46 @@ void LevelModel::refresh()
     for (const auto levelList = Backend::dataDir().entryInfoList({"*.level.json"});
          const auto &fileInfo : levelList) {
         if (const auto index = toInt(fileInfo.baseName())) {
-            if (levelReader.load(fileInfo.fileName()))
-                m_levels += {*index, levelReader.levelName(), fileInfo.filePath()};
+            if (auto name = cachedName(fileInfo))
+                m_levels += {*index, std::move(*name), fileInfo.filePath()};
+            else
+                pending += fileInfo;
         }
     }
 
-    const auto lessByIndexAndName = [](const auto &lhs, const auto &rhs) {
-        return std::tie(lhs.index, lhs.name) < std::tie(rhs.index, rhs.name);
-    };
-
     std::sort(m_levels.begin(), m_levels.end(), lessByIndexAndName);
 
     endResetModel();
+
+    // levels not seen before are added one by one as soon as their name is known
+
+    if (!pending.isEmpty())
+        m_scanner.setFuture(QtConcurrent::mapped(std::move(pending), &LevelModel::scanLevel));
+}
+
+LevelModel::Level LevelModel::scanLevel(const QFileInfo &fileInfo)
+{
+    auto name = readLevelName(fileInfo.filePath());
+
+    if (!name)
+        return {};
+
+    if (name->isEmpty())
+        name = fileInfo.baseName();
+
+    cacheName(fileInfo, *name);
+
+    return {toInt(fileInfo.baseName()).value_or(0), std::move(*name), fileInfo.filePath()};
+}
+
+void LevelModel::insertLevel(Level level)
+{
+    const auto it = std::upper_bound(m_levels.cbegin(), m_levels.cend(), level, lessByIndexAndName);
+    const auto row = static_cast<int>(it - m_levels.cbegin());
+
+    beginInsertRows({}, row, row);
+    m_levels.insert(row, std::move(level));
+    endInsertRows();
 }
 
 } // namespace GameOne
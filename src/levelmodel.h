@@ -2,9 +2,15 @@
 #define GAMEONE_LEVELMODEL_H
 
 #include <QAbstractListModel>
+#include <QFutureWatcher>
+
+class QFileInfo;
 
 namespace GameOne {
 
+// Lists the numbered levels of the data directory. Only the level names are read,
+// in parallel and cached by modification time, so that the list fills in as files
+// are scanned instead of loading every level into a Backend.
 class LevelModel : public QAbstractListModel
 {
     Q_OBJECT
@@ -32,7 +38,11 @@ private:
         QString fileName;
     };
 
+    static Level scanLevel(const QFileInfo &fileInfo);
+    void insertLevel(Level level);
+
     QList<Level> m_levels;
+    QFutureWatcher<Level> m_scanner;
 };
 
 } // namespace GameOne
@@ -1,42 +1,32 @@
 #include "mapmodel.h"
 
 #include "backend.h"
+#include "levelblob.h"
 
 #include <QFile>
 #include <QLoggingCategory>
 #include <QPoint>
 
+#include <limits>
+#include <string_view>
+
 namespace GameOne {
 
 namespace {
-Q_LOGGING_CATEGORY(lcMap, "GameOne.map");
-} // namespace
-
-MapModel::Tile::Tile(const QHash<char, Type> &types, QByteArray spec)
-{
-    auto tspec = spec[0];
-    auto ispec = spec.length() > 1 ? spec[1] : ' ';
 
-    if (tspec == 'T') {
-        tspec = 'G';
-        ispec = '@';
-    } else if (tspec == 'F') {
-        tspec = 'G';
-        ispec = '#';
-    }
+Q_LOGGING_CATEGORY(lcMap, "GameOne.map");
 
-    type = types.value(tspec);
-    item = types.value(ispec);
-}
+// above this number of changed ranges MapModel::apply() resets the model,
+// since views handle one reset faster than many dataChanged() signals
+constexpr auto MaximumChangedRanges = qsizetype{64};
 
-bool MapModel::Tile::isWalkable() const
+bool isWalkable(const MapModel::TileType &tile, const MapModel::TileType &item)
 {
-    if (item.isValid() && !item.walkable)
-        return false;
-
-    return type.walkable;
+    return tile.walkable && (!item.isValid() || item.walkable);
 }
 
+} // namespace
+
 MapModel::MapModel(Backend *backend)
     : MapModel{static_cast<QObject *>(backend)}
 {
@@ -48,7 +38,8 @@ QVariant MapModel::data(const QModelIndex &index, int role) const
     if (hasIndex(index.row(), index.column(), index.parent())) {
         const auto row = index.row() / m_columns;
         const auto column = index.row() % m_columns;
-        const auto tile = m_tiles[index.row()];
+        const auto &type = m_types[m_tileTypes[index.row()]];
+        const auto &item = m_types[m_itemTypes[index.row()]];
 
         switch (static_cast<Role>(role)) {
         case PositionRole:
@@ -58,25 +49,25 @@ QVariant MapModel::data(const QModelIndex &index, int role) const
         case RowRole:
             return row;
         case TypeRole:
-            return tile.type.name;
+            return type.name;
         case ItemTypeRole:
-            return tile.item.name;
+            return item.name;
         case TileColorRole:
-            return tile.type.color;
+            return type.color;
         case TileImageSourceRole:
-            return tile.type.imageSource;
+            return type.imageSource;
         case TileImageCountRole:
-            return tile.type.imageCount;
+            return type.imageCount;
         case ItemColorRole:
-            return tile.item.color;
+            return item.color;
         case ItemImageSourceRole:
-            return tile.item.imageSource;
+            return item.imageSource;
         case ItemImageCountRole:
-            return tile.item.imageCount;
+            return item.imageCount;
         case IsStartRole:
-            return tile.item.isStart;
+            return m_isStart.testBit(index.row());
         case WalkableRole:
-            return tile.isWalkable();
+            return m_walkable.testBit(index.row());
         }
     }
 
@@ -86,9 +77,26 @@ QVariant MapModel::data(const QModelIndex &index, int role) const
 bool MapModel::setData(const QModelIndex &index, const QVariant &value, int role)
 {
     if (hasIndex(index.row(), index.column(), index.parent())) {
-        if (role == IsStartRole && value.canConvert<bool>()) {
-            m_tiles[index.row()].item.isStart = value.toBool();
-            return true;
+        const auto point = QPoint{index.row() % m_columns, index.row() / m_columns};
+
+        switch (role) {
+        case IsStartRole:
+            if (value.canConvert<bool>()) {
+                if (m_isStart.testBit(index.row()) != value.toBool()) {
+                    m_isStart.setBit(index.row(), value.toBool());
+                    emit dataChanged(index, index, {IsStartRole});
+                }
+
+                return true;
+            }
+
+            break;
+
+        case TypeRole:
+            return setTile(point, value.toString());
+
+        case ItemTypeRole:
+            return setItem(point, value.toString());
         }
     }
 
@@ -130,36 +138,66 @@ void MapModel::setBackend(Backend *backend)
         else
             m_tileInfo = {};
 
+        auto table = makeTypes();
+
         beginResetModel();
-        m_tiles.clear();
+        m_types = std::move(table.types);
+        m_keys = table.keys;
+        m_tileTypes.clear();
+        m_itemTypes.clear();
+        m_walkable.clear();
+        m_isStart.clear();
+        m_columns = m_rows = 0;
         endResetModel();
 
         emit backendChanged(m_backend);
     }
 }
 
-QHash<char, MapModel::Tile::Type> MapModel::makeTypes() const
+MapModel::TypeTable MapModel::makeTypes() const
 {
-    QHash<char, Tile::Type> types;
+    TypeTable table;
 
     for (auto it = m_tileInfo.begin(); it != m_tileInfo.end(); ++it) {
+        if (table.types.size() > std::numeric_limits<TypeIndex>::max()) {
+            qCWarning(lcMap, "Too many tile types, ignoring %ls and all following types",
+                      qUtf16Printable(it.key()));
+            break;
+        }
+
         const auto tile = it->toObject();
+        const auto index = static_cast<TypeIndex>(table.types.size());
+        const auto imageSource = Backend::imageUrl(tile["image"].toString());
+        const auto imageCount = tile["imageCount"].toInt(1);
+
+        table.types.append({
+            it.key(),
+            QColor{tile["color"].toString()},
+            imageSource,
+            imageCount,
+            tile["walkable"].toBool(),
+            tile["isStart"].toBool(),
+            m_backend->frameTable(imageSource, imageCount),
+        });
+
+        for (const auto &spec = tile["keys"].toString(); const auto key : spec)
+            table.keys[static_cast<uchar>(key.toLatin1())] = index;
+    }
 
-        for (const auto &spec = tile["keys"].toString(); const auto key : spec) {
-            const QColor color{tile["color"].toString()};
-            const QUrl imageSource = Backend::imageUrl(tile["image"].toString());
-            const auto imageCount = tile["imageCount"].toInt(1);
-            const auto walkable = tile["walkable"].toBool();
-            const auto isStart = tile["isStart"].toBool();
+    return table;
+}
 
-            types.insert(key.toLatin1(), {it.key(), color, imageSource, imageCount, walkable, isStart});
-        }
+bool MapModel::load(const QString &fileName, Format format)
+{
+    if (auto cells = parse(fileName, format)) {
+        apply(std::move(*cells));
+        return true;
     }
 
-    return types;
+    return false;
 }
 
-bool MapModel::load(const QString &fileName, Format format)
+std::optional<MapModel::Cells> MapModel::parse(const QString &fileName, Format format) const
 {
     auto filePath = Backend::dataFileName(fileName);
     auto file = QFile{filePath};
@@ -169,40 +207,258 @@ bool MapModel::load(const QString &fileName, Format format)
                   qUtf16Printable(filePath),
                   qUtf16Printable(file.errorString()));
 
-        return false;
+        return {};
     }
 
-    auto rows = file.readAll().trimmed().split('\n');
+    // uncompressed resources and regular files can be mapped directly,
+    // compressed resources must be read into a temporary buffer
 
-    if (format == CurrentFormat)
-        rows.removeLast();
+    QByteArray buffer;
+    auto text = std::string_view{};
 
-    for (auto &row: rows)
-        row = row.trimmed();
+    if (const auto *const data = file.map(0, file.size())) {
+        text = {reinterpret_cast<const char *>(data), static_cast<std::size_t>(file.size())};
+    } else {
+        buffer = file.readAll();
+        text = {buffer.constData(), static_cast<std::size_t>(buffer.size())};
+    }
+
+    const auto isSpace = [](char ch) { return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n'; };
+    const auto trimmed = [isSpace](std::string_view str) {
+        while (!str.empty() && isSpace(str.front()))
+            str.remove_prefix(1);
+        while (!str.empty() && isSpace(str.back()))
+            str.remove_suffix(1);
+
+        return str;
+    };
 
-    const auto types = makeTypes();
-    QList<Tile> tiles;
+    text = trimmed(text);
 
+    // the current format ends with a line of column numbers
     if (format == CurrentFormat) {
-        for (const auto &row : std::as_const(rows)) {
-            for (int i = 0; i < row.length(); i+= 2)
-                tiles += Tile{types, row.mid(i, 2)};
+        const auto lastLine = text.rfind('\n');
+        text = trimmed(text.substr(0, lastLine == text.npos ? 0 : lastLine));
+    }
+
+    const auto step = std::size_t{format == CurrentFormat ? 2U : 1U};
+    const auto estimatedCellCount = static_cast<qsizetype>(text.size() / step);
+
+    QList<TypeIndex> tileTypes;
+    QList<TypeIndex> itemTypes;
+    tileTypes.reserve(estimatedCellCount);
+    itemTypes.reserve(estimatedCellCount);
+
+    auto rowCount = 0;
+
+    for (auto start = std::size_t{0}; start <= text.size() && !text.empty(); ++rowCount) {
+        const auto end = std::min(text.find('\n', start), text.size());
+        const auto row = trimmed(text.substr(start, end - start));
+        start = end + 1;
+
+        for (auto i = std::size_t{0}; i < row.size(); i += step) {
+            auto tileKey = row[i];
+            auto itemKey = step > 1 && i + 1 < row.size() ? row[i + 1] : ' ';
+
+            if (tileKey == 'T') {
+                tileKey = 'G';
+                itemKey = '@';
+            } else if (tileKey == 'F') {
+                tileKey = 'G';
+                itemKey = '#';
+            }
+
+            tileTypes.append(m_keys[static_cast<uchar>(tileKey)]);
+            itemTypes.append(m_keys[static_cast<uchar>(itemKey)]);
         }
-    } else if (format == LegacyFormat) {
-        for (const auto &row: std::as_const(rows)) {
-            for (int i = 0; i < row.length(); ++i)
-                tiles += Tile{types, row.mid(i, 1)};
+    }
+
+    if (rowCount == 0) {
+        qCWarning(lcMap, "%ls: The map is empty", qUtf16Printable(filePath));
+        return {};
+    }
+
+    return makeCells(std::move(tileTypes), std::move(itemTypes), rowCount);
+}
+
+std::optional<MapModel::Cells> MapModel::parse(const LevelBlob &blob) const
+{
+    const auto typeNames = blob.typeNames();
+    const auto cells = blob.cells();
+
+    if (blob.rows() <= 0 || cells.size() != static_cast<std::size_t>(blob.columns()) * blob.rows() * 2)
+        return {};
+
+    // the compiled level refers to tile types by name,
+    // so that it survives reordering of the tile definitions
+
+    QHash<QString, TypeIndex> indexByName;
+
+    for (auto i = qsizetype{1}; i < m_types.size(); ++i)
+        indexByName.insert(m_types[i].name, static_cast<TypeIndex>(i));
+
+    QList<TypeIndex> blobTypes;
+    blobTypes.reserve(typeNames.size());
+
+    for (const auto &name : typeNames)
+        blobTypes.append(indexByName.value(name));
+
+    const auto typeAt = [&blobTypes](quint8 index) {
+        return index < blobTypes.size() ? blobTypes[index] : TypeIndex{0};
+    };
+
+    QList<TypeIndex> tileTypes;
+    QList<TypeIndex> itemTypes;
+    tileTypes.reserve(static_cast<qsizetype>(cells.size() / 2));
+    itemTypes.reserve(static_cast<qsizetype>(cells.size() / 2));
+
+    for (auto i = std::size_t{0}; i < cells.size(); i += 2) {
+        tileTypes.append(typeAt(cells[i]));
+        itemTypes.append(typeAt(cells[i + 1]));
+    }
+
+    return makeCells(std::move(tileTypes), std::move(itemTypes), blob.rows());
+}
+
+MapModel::Cells MapModel::makeCells(QList<TypeIndex> tileTypes, QList<TypeIndex> itemTypes, int rows) const
+{
+    const auto cellCount = tileTypes.size();
+    auto walkable = QBitArray{cellCount};
+    auto isStart = QBitArray{cellCount};
+
+    for (auto i = qsizetype{0}; i < cellCount; ++i) {
+        const auto &type = m_types[tileTypes[i]];
+        const auto &item = m_types[itemTypes[i]];
+
+        walkable.setBit(i, isWalkable(type, item));
+        isStart.setBit(i, item.isStart);
+    }
+
+    return {std::move(tileTypes), std::move(itemTypes), std::move(walkable), std::move(isStart), rows};
+}
+
+void MapModel::apply(Cells cells)
+{
+    // a map of the same size is updated in place, so that views only
+    // refresh the ranges of cells that differ instead of all delegates;
+    // when too many ranges differ a single reset is cheaper for views
+
+    if (m_rows > 0 && cells.rows == m_rows && cells.tileTypes.size() == m_tileTypes.size()) {
+        QList<std::pair<int, int>> changedRanges;
+
+        for (auto i = 0; i < m_tileTypes.size() && changedRanges.size() <= MaximumChangedRanges; ++i) {
+            if (cells.tileTypes[i] == m_tileTypes[i]
+                    && cells.itemTypes[i] == m_itemTypes[i]
+                    && cells.isStart.testBit(i) == m_isStart.testBit(i))
+                continue;
+
+            if (!changedRanges.isEmpty() && changedRanges.last().second == i - 1)
+                changedRanges.last().second = i;
+            else
+                changedRanges.append({i, i});
+        }
+
+        if (changedRanges.size() <= MaximumChangedRanges) {
+            m_tileTypes = std::move(cells.tileTypes);
+            m_itemTypes = std::move(cells.itemTypes);
+            m_walkable = std::move(cells.walkable);
+            m_isStart = std::move(cells.isStart);
+
+            for (const auto &[first, last] : std::as_const(changedRanges))
+                emit dataChanged(index(first), index(last));
+
+            return;
         }
     }
 
     beginResetModel();
-    m_tiles = std::move(tiles);
-    m_rows = static_cast<int>(rows.count());
-    m_columns = static_cast<int>(m_tiles.size() / m_rows);
+    m_tileTypes = std::move(cells.tileTypes);
+    m_itemTypes = std::move(cells.itemTypes);
+    m_walkable = std::move(cells.walkable);
+    m_isStart = std::move(cells.isStart);
+    m_rows = cells.rows;
+    m_columns = static_cast<int>(m_tileTypes.size() / m_rows);
     endResetModel();
 
     emit columnsChanged(m_columns);
     emit rowsChanged(m_rows);
+}
+
+bool MapModel::setTile(QPoint point, const QString &typeName)
+{
+    if (const auto type = typeIndex(typeName); type && *type != 0)
+        return setTileType(point, *type);
+
+    qCWarning(lcMap, "Unknown tile type: %ls", qUtf16Printable(typeName));
+    return false;
+}
+
+bool MapModel::setItem(QPoint point, const QString &typeName)
+{
+    // an empty type name removes the item
+    if (const auto type = typeName.isEmpty() ? TypeIndex{0} : typeIndex(typeName))
+        return setItemType(point, *type);
+
+    qCWarning(lcMap, "Unknown item type: %ls", qUtf16Printable(typeName));
+    return false;
+}
+
+bool MapModel::setTileType(QPoint point, TypeIndex type)
+{
+    if (!contains(point) || type == 0)
+        return false;
+
+    return updateCell(point, type, m_itemTypes[cellIndex(point)], {
+        TypeRole,
+        TileColorRole,
+        TileImageSourceRole,
+        TileImageCountRole,
+        WalkableRole,
+    });
+}
+
+bool MapModel::setItemType(QPoint point, TypeIndex type)
+{
+    if (!contains(point))
+        return false;
+
+    return updateCell(point, m_tileTypes[cellIndex(point)], type, {
+        ItemTypeRole,
+        ItemColorRole,
+        ItemImageSourceRole,
+        ItemImageCountRole,
+        IsStartRole,
+        WalkableRole,
+    });
+}
+
+std::optional<MapModel::TypeIndex> MapModel::typeIndex(const QString &typeName) const
+{
+    for (auto i = qsizetype{1}; i < m_types.size(); ++i) {
+        if (m_types[i].name == typeName)
+            return static_cast<TypeIndex>(i);
+    }
+
+    return {};
+}
+
+bool MapModel::updateCell(QPoint point, TypeIndex tileType, TypeIndex itemType, const QList<int> &roles)
+{
+    if (tileType >= m_types.size() || itemType >= m_types.size())
+        return false;
+
+    const auto cell = cellIndex(point);
+
+    if (m_tileTypes[cell] == tileType && m_itemTypes[cell] == itemType)
+        return true;
+
+    m_tileTypes[cell] = tileType;
+    m_itemTypes[cell] = itemType;
+    m_walkable.setBit(cell, isWalkable(m_types[tileType], m_types[itemType]));
+    m_isStart.setBit(cell, m_types[itemType].isStart);
+
+    const auto modelIndex = index(static_cast<int>(cell));
+    emit dataChanged(modelIndex, modelIndex, roles);
 
     return true;
 }
@@ -217,6 +473,39 @@ QVariant MapModel::dataByPoint(QPoint point, MapModel::Role role) const
     return data(indexByPoint(point), role);
 }
 
+MapModel::Cells MapModel::cellsInRect(QRect rect) const
+{
+    rect &= QRect{0, 0, m_columns, m_rows};
+
+    const auto cellCount = qsizetype{rect.width()} * rect.height();
+    auto cells = Cells{};
+
+    if (cellCount <= 0)
+        return cells;
+
+    cells.tileTypes.reserve(cellCount);
+    cells.itemTypes.reserve(cellCount);
+    cells.walkable.resize(cellCount);
+    cells.isStart.resize(cellCount);
+    cells.rows = rect.height();
+
+    auto i = qsizetype{0};
+
+    for (auto y = rect.top(); y <= rect.bottom(); ++y) {
+        const auto first = cellIndex({rect.left(), y});
+
+        cells.tileTypes.append(m_tileTypes.sliced(first, rect.width()));
+        cells.itemTypes.append(m_itemTypes.sliced(first, rect.width()));
+
+        for (auto cell = first; cell < first + rect.width(); ++cell, ++i) {
+            cells.walkable.setBit(i, m_walkable.testBit(cell));
+            cells.isStart.setBit(i, m_isStart.testBit(cell));
+        }
+    }
+
+    return cells;
+}
+
 } // namespace GameOne
 
 #include "moc_mapmodel.cpp"
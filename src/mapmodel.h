@@ -2,14 +2,21 @@
 #define GAMEONE_MAPMODEL_H
 
 #include <QAbstractListModel>
+#include <QBitArray>
 #include <QColor>
 #include <QJsonObject>
 #include <QPointer>
+#include <QRect>
 #include <QUrl>
 
+#include <array>
+#include <optional>
+#include <span>
+
 namespace GameOne {
 
 class Backend;
+class LevelBlob;
 
 class MapModel : public QAbstractListModel
 {
@@ -44,6 +51,32 @@ public:
 
     Q_ENUM(Format)
 
+    using TypeIndex = quint8;
+
+    struct TileType
+    {
+        QString name;
+        QColor color;
+        QUrl imageSource;
+        int imageCount = 0;
+        bool walkable = false;
+        bool isStart = false;
+        QList<QUrl> frames = {}; // the image URL of each animation frame
+
+        bool isValid() const { return !name.isEmpty(); }
+    };
+
+    // The parsed cells of a map. Parsing only reads the tile type table,
+    // so that maps can be prepared on worker threads and applied later.
+    struct Cells
+    {
+        QList<TypeIndex> tileTypes;
+        QList<TypeIndex> itemTypes;
+        QBitArray walkable;
+        QBitArray isStart;
+        int rows = 0;
+    };
+
     using QAbstractListModel::QAbstractListModel;
     explicit MapModel(Backend *backend);
 
@@ -58,9 +91,47 @@ public:
 
     Q_INVOKABLE bool load(const QString &fileName, Format format);
 
+    std::optional<Cells> parse(const QString &fileName, Format format) const;
+    std::optional<Cells> parse(const LevelBlob &blob) const;
+    void apply(Cells cells);
+
+    // runtime changes of single cells, like a collapsing bridge or a fire being lit;
+    // only the affected cell is reported via dataChanged()
+
+    Q_INVOKABLE bool setTile(QPoint point, const QString &typeName);
+    Q_INVOKABLE bool setItem(QPoint point, const QString &typeName);
+
+    bool setTileType(QPoint point, TypeIndex type);
+    bool setItemType(QPoint point, TypeIndex type);
+    std::optional<TypeIndex> typeIndex(const QString &typeName) const;
+
     QModelIndex indexByPoint(QPoint point) const;
     QVariant dataByPoint(QPoint point, Role role) const;
 
+    // typed accessors for engine code; the roles above are meant for QML only
+
+    bool contains(QPoint point) const
+    {
+        return point.x() >= 0 && point.x() < m_columns
+            && point.y() >= 0 && point.y() < m_rows;
+    }
+
+    qsizetype cellIndex(QPoint point) const { return qsizetype{point.y()} * m_columns + point.x(); }
+
+    bool isWalkable(QPoint point) const { return contains(point) && m_walkable.testBit(cellIndex(point)); }
+    bool isStartAt(QPoint point) const { return contains(point) && m_isStart.testBit(cellIndex(point)); }
+
+    qsizetype tileTypeCount() const { return m_types.size(); }
+    const TileType &tileType(TypeIndex index) const { return m_types[index]; }
+    const TileType &tileTypeAt(QPoint point) const { return m_types[contains(point) ? m_tileTypes[cellIndex(point)] : 0]; }
+    const TileType &itemTypeAt(QPoint point) const { return m_types[contains(point) ? m_itemTypes[cellIndex(point)] : 0]; }
+
+    std::span<const TypeIndex> tileTypesInRow(int row) const { return rowOf(m_tileTypes, row); }
+    std::span<const TypeIndex> itemTypesInRow(int row) const { return rowOf(m_itemTypes, row); }
+
+    // a copy of the cells within rect, row by row; the rectangle is clipped to the map
+    Cells cellsInRect(QRect rect) const;
+
 public slots:
     void setBackend(GameOne::Backend *backend);
 
@@ -70,33 +141,33 @@ signals:
     void rowsChanged(int rows);
 
 private:
-    struct Tile
+    struct TypeTable
     {
-        struct Type
-        {
-            QString name;
-            QColor color;
-            QUrl imageSource;
-            int imageCount = 0;
-            bool walkable = false;
-            bool isStart = false;
-
-            bool isValid() const { return !name.isEmpty(); }
-        };
-
-        explicit Tile(const QHash<char, Type> &types, QByteArray spec);
+        QList<TileType> types = {TileType{}}; // index 0 is the invalid type
+        std::array<TypeIndex, 256> keys = {};
+    };
 
-        bool isWalkable() const;
+    TypeTable makeTypes() const;
+    Cells makeCells(QList<TypeIndex> tileTypes, QList<TypeIndex> itemTypes, int rows) const;
+    bool updateCell(QPoint point, TypeIndex tileType, TypeIndex itemType, const QList<int> &roles);
 
-        Type type;
-        Type item;
-    };
+    std::span<const TypeIndex> rowOf(const QList<TypeIndex> &cells, int row) const
+    {
+        if (row < 0 || row >= m_rows)
+            return {};
 
-    QHash<char, Tile::Type> makeTypes() const;
+        return {cells.constData() + qsizetype{row} * m_columns, static_cast<std::size_t>(m_columns)};
+    }
 
     QPointer<Backend> m_backend;
     QJsonObject m_tileInfo;
-    QList<Tile> m_tiles;
+
+    QList<TileType> m_types = {TileType{}};
+    std::array<TypeIndex, 256> m_keys = {};
+    QList<TypeIndex> m_tileTypes;
+    QList<TypeIndex> m_itemTypes;
+    QBitArray m_walkable;
+    QBitArray m_isStart;
 
     int m_columns = 0;
     int m_rows = 0;
@@ -0,0 +1,743 @@
+#include "mapview.h"
+
+#include "animationclock.h"
+#include "imageprovider.h"
+#include "mapmodel.h"
+
+#include <QLoggingCategory>
+#include <QPainter>
+#include <QQmlEngine>
+#include <QQuickWindow>
+#include <QSGGeometryNode>
+#include <QSGTextureMaterial>
+#include <QtMath>
+
+#include <rhi/qrhi.h>
+
+namespace GameOne {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcMapView, "GameOne.mapview");
+
+constexpr auto AtlasMaximumSize = 4096; // in pixels, supported by practically all GPUs
+constexpr auto VerticesPerCell = 6;
+
+// the first entry of each atlas stays transparent, it is shown
+// by cells that found no free entry in a full atlas
+constexpr auto PlaceholderEntry = 0;
+
+// A texture that receives the atlas once and then only the regions painted since.
+// The uploads are recorded on the GUI thread and committed on the render thread.
+class AtlasTexture : public QSGTexture
+{
+public:
+    ~AtlasTexture() override
+    {
+        if (m_texture)
+            m_texture->deleteLater();
+    }
+
+    qint64 comparisonKey() const override { return static_cast<qint64>(reinterpret_cast<quintptr>(this)); }
+    QRhiTexture *rhiTexture() const override { return m_texture; }
+    QSize textureSize() const override { return m_size; }
+    bool hasAlphaChannel() const override { return true; }
+    bool hasMipmaps() const override { return false; }
+
+    void setImage(const QImage &image)
+    {
+        m_size = image.size();
+        m_uploads = {{QPoint{}, image}};
+    }
+
+    void updateRect(QPoint topLeft, const QImage &image)
+    {
+        m_uploads.append({topLeft, image});
+    }
+
+    void commitTextureOperations(QRhi *rhi, QRhiResourceUpdateBatch *resourceUpdates) override
+    {
+        if (m_texture == nullptr || m_texture->pixelSize() != m_size) {
+            if (m_texture)
+                m_texture->deleteLater();
+
+            m_texture = rhi->newTexture(QRhiTexture::RGBA8, m_size);
+
+            if (!m_texture->create()) {
+                qCWarning(lcMapView, "Could not create a texture atlas of %dx%d pixels",
+                          m_size.width(), m_size.height());
+            }
+        }
+
+        for (const auto &[topLeft, image] : std::exchange(m_uploads, {})) {
+            auto description = QRhiTextureSubresourceUploadDescription{image};
+            description.setDestinationTopLeft(topLeft);
+            resourceUpdates->uploadTexture(m_texture, QRhiTextureUploadDescription{{0, 0, description}});
+        }
+    }
+
+private:
+    QRhiTexture *m_texture = nullptr;
+    QSize m_size;
+    QList<std::pair<QPoint, QImage>> m_uploads;
+};
+
+class MapNode : public QSGGeometryNode
+{
+public:
+    MapNode()
+        : m_geometry{QSGGeometry::defaultAttributes_TexturedPoint2D(), 0}
+    {
+        m_geometry.setDrawingMode(QSGGeometry::DrawTriangles);
+        setGeometry(&m_geometry);
+
+        m_texture.setFiltering(QSGTexture::Nearest);
+        m_material.setTexture(&m_texture);
+        setMaterial(&m_material);
+    }
+
+    AtlasTexture *texture() { return &m_texture; }
+
+private:
+    QSGGeometry m_geometry;
+    AtlasTexture m_texture;
+    QSGTextureMaterial m_material;
+};
+
+struct EntryKey
+{
+    MapModel::TypeIndex tile;
+    MapModel::TypeIndex item;
+    bool isStart;
+    int tileFrame;
+    int itemFrame;
+
+    quint64 pack() const
+    {
+        return quint64{tile}
+             | quint64{item} << 8U
+             | quint64{isStart} << 16U
+             | static_cast<quint64>(tileFrame & 0xffff) << 17U
+             | static_cast<quint64>(itemFrame & 0xffff) << 33U;
+    }
+
+    static EntryKey unpack(quint64 key)
+    {
+        return {
+            static_cast<MapModel::TypeIndex>(key & 0xffU),
+            static_cast<MapModel::TypeIndex>((key >> 8U) & 0xffU),
+            ((key >> 16U) & 1U) != 0,
+            static_cast<int>((key >> 17U) & 0xffffU),
+            static_cast<int>((key >> 33U) & 0xffffU),
+        };
+    }
+};
+
+} // namespace
+
+MapView::MapView(QQuickItem *parent)
+    : QQuickItem{parent}
+{
+    setFlag(ItemHasContents);
+    setFlag(ItemObservesViewport);
+}
+
+MapView::~MapView()
+{
+    unpinImages();
+}
+
+void MapView::setMap(MapModel *map)
+{
+    if (m_map == map)
+        return;
+
+    if (m_map)
+        m_map->disconnect(this);
+
+    m_map = map;
+
+    if (m_map) {
+        connect(m_map, &MapModel::modelReset, this, &MapView::onModelReset);
+        connect(m_map, &MapModel::dataChanged, this, &MapView::onDataChanged);
+        connect(m_map, &MapModel::backendChanged, this, &MapView::invalidateAtlas);
+    }
+
+    invalidateAtlas();
+    onModelReset();
+
+    emit mapChanged(m_map);
+}
+
+void MapView::setCellSize(qreal cellSize)
+{
+    if (qFuzzyCompare(m_cellSize, cellSize))
+        return;
+
+    m_cellSize = cellSize;
+    invalidateAtlas();
+    updateImplicitSize();
+
+    emit cellSizeChanged(m_cellSize);
+}
+
+void MapView::setClock(AnimationClock *clock)
+{
+    if (m_clock == clock)
+        return;
+
+    m_clock = clock;
+    subscribeFrameCounters();
+
+    for (auto it = m_animatedCells.cbegin(); it != m_animatedCells.cend(); ++it)
+        markAnimatedCellsDirty(it.key());
+
+    emit clockChanged(m_clock);
+}
+
+void MapView::updatePolish()
+{
+    if (!m_map)
+        return;
+
+    if (window() && !qFuzzyCompare(window()->effectiveDevicePixelRatio(), m_devicePixelRatio))
+        invalidateAtlas();
+
+    const auto columns = m_map->columns();
+
+    if (const auto visible = visibleCells(); visible != m_visibleCells) {
+        // cells scrolled out of view release their atlas entries for reuse
+
+        for (auto y = m_visibleCells.top(); y <= m_visibleCells.bottom(); ++y) {
+            for (auto x = m_visibleCells.left(); x <= m_visibleCells.right(); ++x) {
+                if (!visible.contains(x, y))
+                    setCellEntry(m_map->cellIndex({x, y}), -1);
+            }
+        }
+
+        m_visibleCells = visible;
+        m_geometryChanged = true;
+    }
+
+    for (const auto cell : std::exchange(m_dirtyCells, {})) {
+        const auto position = QPoint{static_cast<int>(cell % columns), static_cast<int>(cell / columns)};
+
+        if (!m_visibleCells.contains(position)) {
+            setCellEntry(cell, -1); // resolved once it becomes visible
+            continue;
+        }
+
+        if (setCellEntry(cell, entryFor(cell)))
+            m_changedCells.append(cell);
+    }
+
+    if (m_geometryChanged) {
+        // also retry the cells left with the placeholder, entries might have been released
+
+        for (auto y = m_visibleCells.top(); y <= m_visibleCells.bottom(); ++y) {
+            for (auto x = m_visibleCells.left(); x <= m_visibleCells.right(); ++x) {
+                if (const auto cell = m_map->cellIndex({x, y}); m_cellEntries[cell] <= PlaceholderEntry)
+                    setCellEntry(cell, entryFor(cell));
+            }
+        }
+    }
+
+    update();
+}
+
+QSGNode *MapView::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData * /*data*/)
+{
+    if (!m_map || m_atlas.isNull() || m_visibleCells.isEmpty()) {
+        delete oldNode;
+        return nullptr;
+    }
+
+    auto *node = static_cast<MapNode *>(oldNode);
+
+    if (node == nullptr) {
+        node = new MapNode;
+        m_atlasChanged = true;
+    }
+
+    if (std::exchange(m_atlasChanged, false)) {
+        node->texture()->setImage(m_atlas);
+        node->markDirty(QSGNode::DirtyMaterial);
+        m_paintedRects.clear();
+        m_geometryChanged = true; // texture coordinates depend on the atlas size
+    } else if (!m_paintedRects.isEmpty()) {
+        for (const auto &rect : std::exchange(m_paintedRects, {}))
+            node->texture()->updateRect(rect.topLeft(), m_atlas.copy(rect));
+
+        node->markDirty(QSGNode::DirtyMaterial);
+    }
+
+    const auto textureRect = node->texture()->normalizedTextureSubRect();
+    const auto sx = textureRect.width() * m_entrySize / m_atlas.width();
+    const auto sy = textureRect.height() * m_entrySize / m_atlas.height();
+    const auto columns = m_map->columns();
+
+    const auto setQuad = [&](QSGGeometry::TexturedPoint2D *vertices, qsizetype cell) {
+        const auto x = static_cast<int>(cell % columns);
+        const auto y = static_cast<int>(cell / columns);
+        const auto entry = qMax(m_cellEntries[cell], PlaceholderEntry);
+
+        const auto left = static_cast<float>(x * m_cellSize);
+        const auto top = static_cast<float>(y * m_cellSize);
+        const auto right = static_cast<float>((x + 1) * m_cellSize);
+        const auto bottom = static_cast<float>((y + 1) * m_cellSize);
+
+        const auto tl = static_cast<float>(textureRect.x() + (entry % m_atlasColumns) * sx);
+        const auto tt = static_cast<float>(textureRect.y() + (entry / m_atlasColumns) * sy);
+        const auto tr = static_cast<float>(tl + sx);
+        const auto tb = static_cast<float>(tt + sy);
+
+        vertices[0].set(left, top, tl, tt);
+        vertices[1].set(right, top, tr, tt);
+        vertices[2].set(left, bottom, tl, tb);
+        vertices[3].set(right, top, tr, tt);
+        vertices[4].set(right, bottom, tr, tb);
+        vertices[5].set(left, bottom, tl, tb);
+    };
+
+    const auto slotOf = [this, columns](qsizetype cell) {
+        const auto x = static_cast<int>(cell % columns) - m_visibleCells.left();
+        const auto y = static_cast<int>(cell / columns) - m_visibleCells.top();
+        return qsizetype{y} * m_visibleCells.width() + x;
+    };
+
+    auto *const geometry = node->geometry();
+
+    if (std::exchange(m_geometryChanged, false)) {
+        geometry->allocate(static_cast<int>(qsizetype{m_visibleCells.width()} * m_visibleCells.height() * VerticesPerCell));
+        auto *vertices = geometry->vertexDataAsTexturedPoint2D();
+
+        for (auto y = m_visibleCells.top(); y <= m_visibleCells.bottom(); ++y) {
+            for (auto x = m_visibleCells.left(); x <= m_visibleCells.right(); ++x) {
+                setQuad(vertices, m_map->cellIndex({x, y}));
+                vertices += VerticesPerCell;
+            }
+        }
+
+        m_changedCells.clear();
+        node->markDirty(QSGNode::DirtyGeometry);
+    } else if (!m_changedCells.isEmpty()) {
+        auto *const vertices = geometry->vertexDataAsTexturedPoint2D();
+
+        for (const auto cell : std::exchange(m_changedCells, {})) {
+            if (m_visibleCells.contains(static_cast<int>(cell % columns), static_cast<int>(cell / columns)))
+                setQuad(vertices + slotOf(cell) * VerticesPerCell, cell);
+        }
+
+        node->markDirty(QSGNode::DirtyGeometry);
+    }
+
+    return node;
+}
+
+void MapView::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    polish();
+}
+
+void MapView::onModelReset()
+{
+    const auto cellCount = m_map ? qsizetype{m_map->columns()} * m_map->rows() : 0;
+
+    m_cellEntries = QList<int>(cellCount, -1);
+    m_visibleCells = {};
+    m_dirtyCells.clear();
+    m_changedCells.clear();
+    m_animatedCells.clear();
+
+    releaseEntries();
+
+    for (auto cell = qsizetype{0}; cell < cellCount; ++cell)
+        updateAnimatedCells(cell);
+
+    subscribeFrameCounters();
+
+    m_geometryChanged = true;
+    updateImplicitSize();
+    polish();
+}
+
+void MapView::onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    if (!m_map)
+        return;
+
+    const auto frameCounts = m_animatedCells.size();
+
+    for (auto cell = qsizetype{topLeft.row()}; cell <= bottomRight.row(); ++cell) {
+        const auto row = static_cast<int>(cell / m_map->columns());
+
+        for (auto &rows : m_animatedCells) {
+            if (const auto it = rows.find(row); it != rows.end())
+                it->remove(cell);
+        }
+
+        updateAnimatedCells(cell);
+        markCellDirty(cell);
+    }
+
+    if (m_animatedCells.size() != frameCounts)
+        subscribeFrameCounters();
+}
+
+void MapView::updateAnimatedCells(qsizetype cell)
+{
+    const auto position = QPoint{static_cast<int>(cell % m_map->columns()),
+                                 static_cast<int>(cell / m_map->columns())};
+
+    if (const auto frameCount = m_map->tileTypeAt(position).imageCount; frameCount > 1)
+        m_animatedCells[frameCount][position.y()].insert(cell);
+    if (const auto frameCount = m_map->itemTypeAt(position).imageCount; frameCount > 1)
+        m_animatedCells[frameCount][position.y()].insert(cell);
+}
+
+void MapView::markAnimatedCellsDirty(int frameCount)
+{
+    // only visible cells need a new frame, the others are resolved once they scroll into view;
+    // indexing by row keeps the cost independent of the animated cells outside of the view
+
+    const auto rows = m_animatedCells.constFind(frameCount);
+
+    if (rows == m_animatedCells.cend() || m_visibleCells.isEmpty())
+        return;
+
+    for (auto it = rows->lowerBound(m_visibleCells.top()); it != rows->cend() && it.key() <= m_visibleCells.bottom(); ++it) {
+        for (const auto cell : *it) {
+            if (const auto x = static_cast<int>(cell % m_map->columns());
+                    x >= m_visibleCells.left() && x <= m_visibleCells.right())
+                markCellDirty(cell);
+        }
+    }
+}
+
+void MapView::subscribeFrameCounters()
+{
+    // static cells never change their appearance, so only the cells
+    // of an animation need an update when its frame counter advances
+
+    for (const auto &connection : std::exchange(m_frameConnections, {}))
+        disconnect(connection);
+
+    if (!m_clock)
+        return;
+
+    for (auto it = m_animatedCells.cbegin(); it != m_animatedCells.cend(); ++it) {
+        const auto frameCount = it.key();
+
+        if (auto *const counter = m_clock->counter(frameCount)) {
+            m_frameConnections += connect(counter, &FrameCounter::frameChanged, this, [this, frameCount] {
+                markAnimatedCellsDirty(frameCount);
+            });
+        }
+    }
+}
+
+int MapView::frameOf(MapModel::TypeIndex type) const
+{
+    return m_clock ? m_clock->frame(m_map->tileType(type).imageCount) : 0;
+}
+
+void MapView::invalidateAtlas()
+{
+    m_devicePixelRatio = window() ? window()->effectiveDevicePixelRatio() : 1.0;
+
+    unpinImages();
+
+    m_entrySize = qMax(qCeil(m_cellSize * m_devicePixelRatio), 1);
+    m_atlasColumns = qMax(AtlasMaximumSize / m_entrySize, 1);
+    m_maximumEntryCount = m_atlasColumns * m_atlasColumns;
+
+    m_entries.clear();
+    m_entrySlots.clear();
+    m_releasedEntries.clear();
+    m_paintedRects.clear();
+    m_atlas = {};
+    m_cellEntries.fill(-1);
+    m_changedCells.clear();
+    m_atlasOverflowed = false;
+
+    allocateEntry(); // the placeholder
+
+    m_atlasChanged = true;
+    m_geometryChanged = true;
+    polish();
+}
+
+void MapView::unpinImages()
+{
+    for (auto &entry : m_entrySlots)
+        unpinImages(entry);
+}
+
+void MapView::unpinImages(Entry &entry)
+{
+    if (m_imageProvider) {
+        for (const auto &id : std::as_const(entry.images))
+            m_imageProvider->unpin(id, {m_entrySize, m_entrySize});
+    }
+
+    entry.images.clear();
+}
+
+void MapView::markCellDirty(qsizetype cell)
+{
+    m_dirtyCells.append(cell);
+    polish();
+}
+
+void MapView::updateImplicitSize()
+{
+    if (m_map) {
+        setImplicitSize(m_map->columns() * m_cellSize, m_map->rows() * m_cellSize);
+    } else {
+        setImplicitSize(0, 0);
+    }
+}
+
+QRect MapView::visibleCells() const
+{
+    if (!m_map || m_cellSize <= 0)
+        return {};
+
+    // clipRect() is limited to the viewport because of ItemObservesViewport
+    const auto area = clipRect() & boundingRect();
+
+    if (area.isEmpty())
+        return {};
+
+    const auto topLeft = QPoint{qFloor(area.left() / m_cellSize), qFloor(area.top() / m_cellSize)};
+    const auto bottomRight = QPoint{qCeil(area.right() / m_cellSize) - 1, qCeil(area.bottom() / m_cellSize) - 1};
+
+    return QRect{topLeft, bottomRight} & QRect{0, 0, m_map->columns(), m_map->rows()};
+}
+
+quint64 MapView::entryKey(qsizetype cell) const
+{
+    const auto row = static_cast<int>(cell / m_map->columns());
+    const auto column = static_cast<std::size_t>(cell % m_map->columns());
+    const auto tile = m_map->tileTypesInRow(row)[column];
+    const auto item = m_map->itemTypesInRow(row)[column];
+
+    return EntryKey{
+        tile, item, m_map->isStartAt({static_cast<int>(column), row}),
+        frameOf(tile),
+        frameOf(item),
+    }.pack();
+}
+
+int MapView::entryFor(qsizetype cell)
+{
+    const auto key = entryKey(cell);
+
+    if (const auto it = m_entries.constFind(key); it != m_entries.cend())
+        return *it;
+
+    const auto entry = allocateEntry();
+
+    if (entry < 0) {
+        if (!std::exchange(m_atlasOverflowed, true))
+            qCWarning(lcMapView, "All %d entries of the texture atlas are visible, some cells stay empty",
+                      m_maximumEntryCount);
+
+        return PlaceholderEntry;
+    }
+
+    m_entrySlots[entry].key = key;
+    m_entries.insert(key, entry);
+    paintEntry(entry, key);
+
+    return entry;
+}
+
+int MapView::allocateEntry()
+{
+    if (m_entrySlots.size() < m_maximumEntryCount) {
+        const auto entry = static_cast<int>(m_entrySlots.size());
+        const auto requiredHeight = (entry / m_atlasColumns + 1) * m_entrySize;
+        m_entrySlots.append({});
+
+        // growing the atlas uploads it as a whole, which happens a few times at most
+
+        if (m_atlas.height() < requiredHeight) {
+            const auto maximumRows = m_maximumEntryCount / m_atlasColumns;
+            const auto rows = qMin(qMax(4, 2 * requiredHeight / m_entrySize), maximumRows);
+            auto atlas = QImage{m_atlasColumns * m_entrySize, rows * m_entrySize, QImage::Format_RGBA8888_Premultiplied};
+            atlas.fill(Qt::transparent);
+
+            if (!m_atlas.isNull()) {
+                auto painter = QPainter{&atlas};
+                painter.setCompositionMode(QPainter::CompositionMode_Source);
+                painter.drawImage(0, 0, m_atlas);
+            }
+
+            m_atlas = std::move(atlas);
+            m_atlasChanged = true;
+        }
+
+        return entry;
+    }
+
+    // the atlas is full, so the entry that is unused for the longest time gets replaced
+
+    while (!m_releasedEntries.isEmpty()) {
+        if (const auto entry = m_releasedEntries.takeFirst(); m_entrySlots[entry].references == 0) {
+            m_entries.remove(m_entrySlots[entry].key);
+            unpinImages(m_entrySlots[entry]); // the new appearance needs other images
+            return entry;
+        }
+    }
+
+    return -1;
+}
+
+bool MapView::setCellEntry(qsizetype cell, int entry)
+{
+    const auto previous = std::exchange(m_cellEntries[cell], entry);
+
+    if (previous == entry)
+        return false;
+
+    // the placeholder is never reused, so its references are not counted
+
+    if (entry > PlaceholderEntry)
+        ++m_entrySlots[entry].references;
+
+    if (previous > PlaceholderEntry && --m_entrySlots[previous].references == 0) {
+        m_releasedEntries.append(previous);
+
+        // forget entries that are in use again, and all but the latest release of the others
+
+        if (m_releasedEntries.size() > 2 * m_entrySlots.size()) {
+            auto released = QList<int>{};
+            auto seen = QSet<int>{};
+
+            for (auto it = m_releasedEntries.crbegin(); it != m_releasedEntries.crend(); ++it) {
+                if (m_entrySlots[*it].references == 0 && !seen.contains(*it)) {
+                    seen.insert(*it);
+                    released.prepend(*it);
+                }
+            }
+
+            m_releasedEntries = std::move(released);
+        }
+    }
+
+    return true;
+}
+
+void MapView::releaseEntries()
+{
+    m_releasedEntries.clear();
+
+    for (auto entry = PlaceholderEntry + 1; entry < m_entrySlots.size(); ++entry) {
+        m_entrySlots[entry].references = 0;
+        m_releasedEntries.append(entry);
+    }
+}
+
+void MapView::paintEntry(int entry, quint64 key)
+{
+    const auto spec = EntryKey::unpack(key);
+    const auto &tile = m_map->tileType(spec.tile);
+    const auto &item = m_map->tileType(spec.item);
+
+    const auto scale = m_entrySize / m_cellSize;
+    const auto target = QRect{(entry % m_atlasColumns) * m_entrySize, (entry / m_atlasColumns) * m_entrySize,
+                              m_entrySize, m_entrySize};
+
+    m_paintedRects.append(target);
+
+    auto painter = QPainter{&m_atlas};
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setClipRect(target);
+
+    // reused entries still contain the previous appearance
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(target, Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+
+    if (tile.color.isValid())
+        painter.fillRect(target, tile.color);
+
+    const auto borderWidth = scale;
+    painter.setPen(QPen{Qt::black, borderWidth});
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(QRectF{target}.adjusted(borderWidth / 2, borderWidth / 2, -borderWidth / 2, -borderWidth / 2));
+
+    if (const auto image = requestImage(entry, tile.frames.value(spec.tileFrame)); !image.isNull())
+        painter.drawImage(target, image);
+
+    if (const auto image = requestImage(entry, item.frames.value(spec.itemFrame)); !image.isNull()) {
+        painter.drawImage(target, image);
+    } else if (item.isValid() && !spec.isStart && item.imageSource.isEmpty()) {
+        const auto radius = (m_cellSize / 2 - 4) * scale;
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(item.color);
+        painter.drawEllipse(QRectF{target}.center(), radius, radius);
+    }
+}
+
+QImage MapView::requestImage(int entry, const QUrl &frameUrl)
+{
+    // images that are not rendered yet are requested in the background; until they are
+    // ready the entry shows just the tile color, and is painted again once they arrive
+
+    if (frameUrl.isEmpty())
+        return {};
+
+    auto *const engine = qmlEngine(this);
+    auto *const provider = engine ? dynamic_cast<ImageProvider *>(engine->imageProvider(frameUrl.host())) : nullptr;
+
+    if (provider == nullptr)
+        return {};
+
+    const auto id = frameUrl.toString(QUrl::RemoveScheme | QUrl::RemoveAuthority).mid(1);
+    const auto requestedSize = QSize{m_entrySize, m_entrySize};
+
+    // keep the images of the atlas in memory as long as the entry exists, so that
+    // the atlas can be rebuilt quickly; each entry pins every image only once
+
+    if (m_imageProvider != provider) {
+        unpinImages();
+        m_imageProvider = provider;
+    }
+
+    // the assets of the next level get prefetched at the size the map is shown at
+    provider->setPrefetchSize(requestedSize);
+
+    if (auto &images = m_entrySlots[entry].images; !images.contains(id)) {
+        provider->pin(id, requestedSize);
+        images.append(id);
+    }
+
+    if (auto image = provider->cachedImage(id, requestedSize); !image.isNull())
+        return image;
+
+    const auto key = m_entrySlots[entry].key;
+
+    provider->requestFrame(id, requestedSize).then(this, [this, entry, key](const QImage &image) {
+        if (!image.isNull()) // failed renderings would otherwise be requested again and again
+            onImageRendered(entry, key);
+    });
+
+    return {};
+}
+
+void MapView::onImageRendered(int entry, quint64 key)
+{
+    // the atlas might have been rebuilt, or the entry reused, while the image was rendering
+    if (entry >= m_entrySlots.size() || m_entrySlots[entry].key != key)
+        return;
+
+    paintEntry(entry, key);
+    update();
+}
+
+} // namespace GameOne
+
+#include "moc_mapview.cpp"
@@ -0,0 +1,115 @@
+#ifndef GAMEONE_MAPVIEW_H
+#define GAMEONE_MAPVIEW_H
+
+#include "mapmodel.h"
+
+#include <QImage>
+#include <QMap>
+#include <QPointer>
+#include <QQuickItem>
+#include <QSet>
+
+namespace GameOne {
+
+class AnimationClock;
+class ImageProvider;
+
+// Renders all cells of a MapModel as textured quads of a single scene-graph node.
+// Each distinct cell appearance is painted once into a texture atlas, only cells in
+// the visible area get geometry, and only changed or animated cells are updated.
+// The atlas has a fixed maximum size: slots no longer used by any visible cell are
+// reused for new appearances, and only the slots painted since the last frame are
+// uploaded to the texture. When all slots are visible, further cells stay empty.
+class MapView : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(GameOne::MapModel *map READ map WRITE setMap NOTIFY mapChanged FINAL)
+    Q_PROPERTY(qreal cellSize READ cellSize WRITE setCellSize NOTIFY cellSizeChanged FINAL)
+    Q_PROPERTY(GameOne::AnimationClock *clock READ clock WRITE setClock NOTIFY clockChanged FINAL)
+
+public:
+    explicit MapView(QQuickItem *parent = nullptr);
+    ~MapView() override;
+
+    MapModel *map() const { return m_map.data(); }
+    void setMap(MapModel *map);
+
+    qreal cellSize() const { return m_cellSize; }
+    void setCellSize(qreal cellSize);
+
+    AnimationClock *clock() const { return m_clock.data(); }
+    void setClock(AnimationClock *clock);
+
+signals:
+    void mapChanged(GameOne::MapModel *map);
+    void cellSizeChanged(qreal cellSize);
+    void clockChanged(GameOne::AnimationClock *clock);
+
+protected:
+    void updatePolish() override;
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+
+private:
+    struct Entry
+    {
+        quint64 key;
+        int references = 0; // number of visible cells showing this entry
+        QStringList images; // pinned in the image provider's cache while the entry exists
+    };
+
+    void onModelReset();
+    void onDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+
+    void updateAnimatedCells(qsizetype cell);
+    void markAnimatedCellsDirty(int frameCount);
+    void subscribeFrameCounters();
+    int frameOf(MapModel::TypeIndex type) const;
+
+    void invalidateAtlas();
+    void unpinImages();
+    void unpinImages(Entry &entry);
+    void markCellDirty(qsizetype cell);
+    void updateImplicitSize();
+
+    QRect visibleCells() const;
+    quint64 entryKey(qsizetype cell) const;
+    int entryFor(qsizetype cell);
+    int allocateEntry();
+    bool setCellEntry(qsizetype cell, int entry);
+    void releaseEntries();
+    void paintEntry(int entry, quint64 key);
+    QImage requestImage(int entry, const QUrl &frameUrl);
+    void onImageRendered(int entry, quint64 key);
+
+    QPointer<MapModel> m_map;
+    qreal m_cellSize = 60;
+    QPointer<AnimationClock> m_clock;
+    QList<QMetaObject::Connection> m_frameConnections;
+
+    // GUI thread state, read by updatePaintNode() while the GUI thread is blocked
+    QList<int> m_cellEntries; // -1 for cells outside of the visible area
+    QHash<int, QMap<int, QSet<qsizetype>>> m_animatedCells; // by frame count and row
+    QList<qsizetype> m_dirtyCells;
+    QHash<quint64, int> m_entries;
+    QList<Entry> m_entrySlots;
+    QList<int> m_releasedEntries; // oldest first, may contain entries in use again
+    QImage m_atlas;
+    QList<QRect> m_paintedRects;
+    qreal m_devicePixelRatio = 1.0;
+    int m_entrySize = 0;
+    int m_atlasColumns = 1;
+    int m_maximumEntryCount = 0;
+    QRect m_visibleCells;
+
+    QPointer<ImageProvider> m_imageProvider;
+
+    bool m_atlasChanged = false;
+    bool m_atlasOverflowed = false;
+    bool m_geometryChanged = true;
+    QList<qsizetype> m_changedCells;
+};
+
+} // namespace GameOne
+
+#endif // GAMEONE_MAPVIEW_H
@@ -0,0 +1,219 @@
+#include "pathfinder.h"
+
+#include "mapmodel.h"
+
+#include <QHash>
+
+#include <array>
+#include <limits>
+#include <queue>
+#include <tuple>
+
+namespace GameOne {
+
+namespace {
+
+using Direction = Actor::Direction;
+
+constexpr auto Directions = std::array{Direction::Up, Direction::Left, Direction::Right, Direction::Down};
+constexpr auto NotVisited = std::numeric_limits<quint16>::max();
+
+} // namespace
+
+void PathFinder::reset(const MapModel *map)
+{
+    m_map = map;
+    m_distances.clear();
+    m_visited.clear();
+    m_isValid = false;
+}
+
+void PathFinder::setTarget(QPoint target)
+{
+    if (m_isValid && target == m_target)
+        return;
+
+    m_target = target;
+    updateFlowField();
+}
+
+int PathFinder::distance(QPoint point) const
+{
+    if (!m_isValid || !m_map || !m_map->contains(point))
+        return Unreachable;
+
+    const auto cell = m_map->cellIndex(point);
+
+    if (cell >= m_distances.size() || m_distances[cell] == NotVisited)
+        return Unreachable;
+
+    return m_distances[cell];
+}
+
+Actor::Direction PathFinder::direction(QPoint from, Random &random) const
+{
+    auto bestDistance = distance(from);
+    auto bestDirection = Direction::None;
+    auto tieCount = 0;
+
+    if (bestDistance == Unreachable)
+        return bestDirection;
+
+    for (const auto direction : Directions) {
+        const auto d = distance(from + step(direction));
+
+        if (d == Unreachable || d > bestDistance)
+            continue;
+
+        if (d < bestDistance) {
+            bestDistance = d;
+            bestDirection = direction;
+            tieCount = 1;
+        } else if (tieCount > 0 && random.bounded(++tieCount) == 0) {
+            bestDirection = direction; // each of the tied directions wins with equal chance
+        }
+    }
+
+    return bestDirection;
+}
+
+QList<QPoint> PathFinder::findPath(QPoint from, QPoint to, qsizetype maximumVisits) const
+{
+    if (!m_map || !m_map->contains(from) || !m_map->isWalkable(to))
+        return {};
+
+    struct Node
+    {
+        int estimate;
+        int cost;
+        qsizetype cell;
+    };
+
+    // the open list prefers the lowest estimate, and the deepest node on ties
+    const auto isWorse = [](const Node &lhs, const Node &rhs) {
+        return std::tie(lhs.estimate, rhs.cost) > std::tie(rhs.estimate, lhs.cost);
+    };
+
+    const auto columns = m_map->columns();
+    const auto pointOf = [columns](qsizetype cell) {
+        return QPoint{static_cast<int>(cell % columns), static_cast<int>(cell / columns)};
+    };
+
+    const auto start = m_map->cellIndex(from);
+    const auto goal = m_map->cellIndex(to);
+
+    // large maps are searched sparsely, the hashes only hold the cells that were reached
+
+    auto open = std::priority_queue<Node, std::vector<Node>, decltype(isWorse)>{isWorse};
+    auto costs = QHash<qsizetype, int>{{start, 0}};
+    auto cameFrom = QHash<qsizetype, qsizetype>{};
+    auto visits = qsizetype{0};
+
+    open.push({(to - from).manhattanLength(), 0, start});
+
+    while (!open.empty() && visits < maximumVisits) {
+        const auto node = open.top();
+        open.pop();
+
+        if (node.cost > costs.value(node.cell))
+            continue; // a shorter route to this cell was found meanwhile
+
+        if (node.cell == goal) {
+            auto path = QList<QPoint>{};
+
+            for (auto cell = goal; cell != start; cell = cameFrom.value(cell))
+                path.prepend(pointOf(cell));
+
+            return path;
+        }
+
+        ++visits;
+
+        for (const auto direction : Directions) {
+            const auto next = pointOf(node.cell) + step(direction);
+
+            if (!m_map->isWalkable(next))
+                continue;
+
+            const auto nextCell = m_map->cellIndex(next);
+            const auto cost = node.cost + 1;
+
+            if (const auto it = costs.constFind(nextCell); it != costs.cend() && *it <= cost)
+                continue;
+
+            costs.insert(nextCell, cost);
+            cameFrom.insert(nextCell, node.cell);
+            open.push({cost + (to - next).manhattanLength(), cost, nextCell});
+        }
+    }
+
+    return {};
+}
+
+QPoint PathFinder::step(Actor::Direction direction)
+{
+    switch (direction) {
+    case Direction::Up:
+        return {0, -1};
+    case Direction::Left:
+        return {-1, 0};
+    case Direction::Right:
+        return {+1, 0};
+    case Direction::Down:
+        return {0, +1};
+    case Direction::None:
+        break;
+    }
+
+    return {};
+}
+
+void PathFinder::updateFlowField()
+{
+    const auto cellCount = m_map ? qsizetype{m_map->columns()} * m_map->rows() : 0;
+
+    if (m_distances.size() != cellCount) {
+        m_distances.fill(NotVisited, cellCount);
+    } else {
+        for (const auto cell : std::as_const(m_visited))
+            m_distances[cell] = NotVisited;
+    }
+
+    m_visited.clear();
+    m_isValid = true;
+
+    if (!m_map || !m_map->contains(m_target))
+        return;
+
+    // m_visited doubles as the queue of the breadth-first search
+
+    const auto columns = m_map->columns();
+    const auto seed = m_map->cellIndex(m_target);
+
+    m_distances[seed] = 0;
+    m_visited.append(seed);
+
+    for (auto i = qsizetype{0}; i < m_visited.size(); ++i) {
+        const auto cell = m_visited[i];
+        const auto distance = m_distances[cell];
+
+        if (distance >= MaximumDistance)
+            continue;
+
+        const auto point = QPoint{static_cast<int>(cell % columns), static_cast<int>(cell / columns)};
+
+        for (const auto direction : Directions) {
+            const auto next = point + step(direction);
+
+            if (!m_map->isWalkable(next))
+                continue;
+
+            if (const auto nextCell = m_map->cellIndex(next); m_distances[nextCell] == NotVisited) {
+                m_distances[nextCell] = static_cast<quint16>(distance + 1);
+                m_visited.append(nextCell);
+            }
+        }
+    }
+}
+
+} // namespace GameOne
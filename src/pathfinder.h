@@ -0,0 +1,58 @@
+#ifndef GAMEONE_PATHFINDER_H
+#define GAMEONE_PATHFINDER_H
+
+#include "actors.h"
+
+#include <QList>
+#include <QPoint>
+#include <QPointer>
+
+namespace GameOne {
+
+class MapModel;
+
+// Finds routes over the walkable cells of a MapModel. Actors are not obstacles here,
+// occupied cells are resolved when the move is performed.
+//
+// The flow field holds the walking distance of each cell to a shared target, e.g. the
+// player, so that any number of enemies can follow it by stepping to a neighbour that
+// is closer. It is filled by a breadth-first search, which is Dijkstra's algorithm for
+// uniform step costs, and only reaches MaximumDistance steps far. Only cells visited by
+// the previous search are cleared again, so that moving the target by one cell costs a
+// few thousand cell visits independent of the map size.
+//
+// findPath() runs A* between two arbitrary cells for enemies that need their own route.
+class PathFinder
+{
+public:
+    static constexpr int MaximumDistance = 48;
+    static constexpr int Unreachable = -1;
+
+    void reset(const MapModel *map);
+    void invalidate() { m_isValid = false; }
+
+    QPoint target() const { return m_target; }
+    void setTarget(QPoint target);
+
+    int distance(QPoint point) const;
+    // the step towards the target, ties between equally close neighbours are broken randomly
+    Actor::Direction direction(QPoint from, Random &random) const;
+
+    QList<QPoint> findPath(QPoint from, QPoint to, qsizetype maximumVisits = 16384) const;
+
+    static QPoint step(Actor::Direction direction);
+
+private:
+    void updateFlowField();
+
+    QPointer<const MapModel> m_map;
+    QPoint m_target;
+    bool m_isValid = false;
+
+    QList<quint16> m_distances;
+    QList<qsizetype> m_visited;
+};
+
+} // namespace GameOne
+
+#endif // GAMEONE_PATHFINDER_H
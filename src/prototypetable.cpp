@@ -0,0 +1,138 @@
+#include "prototypetable.h"
+
+#include <QFile>
+#include <QLoggingCategory>
+
+namespace GameOne {
+
+namespace {
+
+Q_LOGGING_CATEGORY(lcPrototypes, "GameOne.prototypes");
+
+} // namespace
+
+PrototypeTable::PrototypeTable(QUrl baseUrl)
+    : m_baseUrl{std::move(baseUrl)}
+{}
+
+void PrototypeTable::compile()
+{
+    const auto sections = resolve(m_baseUrl);
+
+    for (auto section = sections.begin(); section != sections.end(); ++section) {
+        auto sectionRef = m_baseUrl;
+        sectionRef.setFragment(section.key());
+
+        const auto entries = prototype(sectionRef);
+
+        for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+            auto entryRef = sectionRef;
+            entryRef.setFragment(section.key() + '/' + entry.key());
+            prototype(entryRef);
+        }
+    }
+
+    qCDebug(lcPrototypes, "Compiled %lld prototypes", static_cast<long long>(m_prototypes.size()));
+}
+
+QJsonObject PrototypeTable::resolve(QJsonObject object)
+{
+    if (const auto ref = object.find("$ref"); ref != object.end()) {
+        const auto json = resolve(QUrl{ref->toString()});
+        object.erase(ref);
+
+        for (auto it = json.begin(); it != json.end(); ++it) {
+            if (!object.contains(it.key()))
+                object.insert(it.key(), it.value());
+        }
+    }
+
+    return object;
+}
+
+QJsonObject PrototypeTable::resolve(const QUrl &ref)
+{
+    if (ref.isEmpty())
+        return {};
+
+    return prototype(canonicalRef(ref));
+}
+
+QUrl PrototypeTable::canonicalRef(QUrl ref) const
+{
+    if (ref.path().isEmpty()) {
+        ref.setScheme(m_baseUrl.scheme());
+        ref.setPath(m_baseUrl.path());
+    } else if (ref.isRelative()) {
+        ref = m_baseUrl.resolved(ref);
+    }
+
+    // "#a//b/" and "#a/b" name the same prototype, just like "" and "#"
+    const auto path = ref.fragment().split('/', Qt::SkipEmptyParts);
+    ref.setFragment(path.isEmpty() ? QString{} : path.join('/'));
+
+    return ref;
+}
+
+QJsonObject PrototypeTable::prototype(const QUrl &ref)
+{
+    if (const auto it = m_prototypes.constFind(ref); it != m_prototypes.cend())
+        return *it;
+
+    if (m_resolving.contains(ref)) {
+        qCWarning(lcPrototypes, "%ls: Cyclic reference", qUtf16Printable(ref.toDisplayString()));
+        return {};
+    }
+
+    m_resolving.insert(ref);
+
+    // a prototype is its parent's member with that member's own reference resolved,
+    // so the prototypes of all parents get flattened and memoized along the way
+
+    auto object = QJsonObject{};
+
+    if (const auto fragment = ref.fragment(); fragment.isEmpty()) {
+        object = document(ref.adjusted(QUrl::RemoveFragment)).object();
+    } else {
+        const auto separator = fragment.lastIndexOf('/');
+
+        auto parentRef = ref;
+        parentRef.setFragment(separator < 0 ? QString{} : fragment.left(separator));
+
+        object = resolve(prototype(parentRef)[fragment.mid(separator + 1)].toObject());
+    }
+
+    m_resolving.remove(ref);
+
+    return *m_prototypes.insert(ref, object);
+}
+
+QJsonDocument PrototypeTable::document(const QUrl &url)
+{
+    if (const auto it = m_documents.constFind(url); it != m_documents.cend())
+        return *it;
+
+    if (url.scheme() != "qrc") {
+        qCWarning(lcPrototypes, "%ls: Unsupported URL", qUtf16Printable(url.toDisplayString()));
+        return {};
+    }
+
+    QFile file{":" + url.path()};
+
+    if (!file.open(QFile::ReadOnly)) {
+        qCWarning(lcPrototypes, "%ls: %ls", qUtf16Printable(url.toDisplayString()), qUtf16Printable(file.errorString()));
+        return {};
+    }
+
+    QJsonParseError status;
+    const auto document = QJsonDocument::fromJson(file.readAll(), &status);
+
+    if (status.error != QJsonParseError::NoError) {
+        qCWarning(lcPrototypes, "%ls: %ls", qUtf16Printable(url.toDisplayString()), qUtf16Printable(status.errorString()));
+        return {};
+    }
+
+    return *m_documents.insert(url, document);
+}
+
+} // namespace GameOne
@@ -0,0 +1,42 @@
+#ifndef GAMEONE_PROTOTYPETABLE_H
+#define GAMEONE_PROTOTYPETABLE_H
+
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QUrl>
+
+namespace GameOne {
+
+// Resolves the "$ref" chains of the game's JSON files. Each reference is
+// flattened only once into a prototype, which then is shared by all
+// objects that refer to it. Instances just overlay their own fields.
+class PrototypeTable
+{
+public:
+    explicit PrototypeTable(QUrl baseUrl = QUrl{"qrc:/GameOne/data/basics.json"});
+
+    // flattens all prototypes reachable from the base document's top-level sections
+    void compile();
+
+    QJsonObject resolve(QJsonObject object);
+    QJsonObject resolve(const QUrl &ref);
+
+    qsizetype count() const { return m_prototypes.size(); }
+
+private:
+    QUrl canonicalRef(QUrl ref) const;
+    QJsonObject prototype(const QUrl &ref);
+    QJsonDocument document(const QUrl &url);
+
+    const QUrl m_baseUrl;
+
+    QHash<QUrl, QJsonDocument> m_documents;
+    QHash<QUrl, QJsonObject> m_prototypes;
+    QSet<QUrl> m_resolving;
+};
+
+} // namespace GameOne
+
+#endif // GAMEONE_PROTOTYPETABLE_H
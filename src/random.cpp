@@ -0,0 +1,81 @@
+#include "random.h"
+
+#include <bit>
+
+namespace GameOne {
+
+namespace {
+
+quint64 splitMix64(quint64 &state)
+{
+    auto z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30U)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27U)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31U);
+}
+
+} // namespace
+
+Random::Random(quint64 seed)
+{
+    for (auto &word : m_state)
+        word = splitMix64(seed);
+}
+
+Random::result_type Random::operator()()
+{
+    const auto result = std::rotl(m_state[1] * 5, 7) * 9;
+    const auto t = m_state[1] << 17U;
+
+    m_state[2] ^= m_state[0];
+    m_state[3] ^= m_state[1];
+    m_state[1] ^= m_state[2];
+    m_state[0] ^= m_state[3];
+    m_state[2] ^= t;
+    m_state[3] = std::rotl(m_state[3], 45);
+
+    return result;
+}
+
+int Random::bounded(int bound)
+{
+    if (bound <= 0)
+        return 0;
+
+    // Lemire's multiply-shift reduction; the bias is negligible for our small bounds
+    return static_cast<int>(((*this)() >> 32U) * static_cast<quint64>(bound) >> 32U);
+}
+
+Random Random::split()
+{
+    // hand out the current sequence and continue 2^128 steps later,
+    // which gives non-overlapping streams for any practical number of actors
+    auto stream = *this;
+    jump();
+    return stream;
+}
+
+void Random::jump()
+{
+    static constexpr auto s_jump = std::array<quint64, 4>{
+        0x180ec6d33cfd0aba, 0xd5a61266f0c9392c,
+        0xa9582618e03fc9aa, 0x39abdc4529b1661c,
+    };
+
+    auto state = std::array<quint64, 4>{};
+
+    for (const auto word : s_jump) {
+        for (auto bit = 0U; bit < 64U; ++bit) {
+            if (word & (quint64{1} << bit)) {
+                for (auto i = std::size_t{0}; i < state.size(); ++i)
+                    state[i] ^= m_state[i];
+            }
+
+            (*this)();
+        }
+    }
+
+    m_state = state;
+}
+
+} // namespace GameOne
@@ -0,0 +1,35 @@
+#ifndef GAMEONE_RANDOM_H
+#define GAMEONE_RANDOM_H
+
+#include <QtTypes>
+
+#include <array>
+
+namespace GameOne {
+
+// A small, seedable xoshiro256** generator. Unlike std::rand() it carries its own state,
+// so that each actor can own an independent stream and game sessions can be replayed.
+class Random
+{
+public:
+    using result_type = quint64;
+
+    explicit Random(quint64 seed = 0);
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type{0}; }
+
+    result_type operator()();
+    int bounded(int bound);
+
+    Random split();
+
+private:
+    void jump();
+
+    std::array<quint64, 4> m_state;
+};
+
+} // namespace GameOne
+
+#endif // GAMEONE_RANDOM_H
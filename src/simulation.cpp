@@ -0,0 +1,54 @@
+#include "simulation.h"
+
+#include <QtConcurrent/QtConcurrentMap>
+
+namespace GameOne {
+
+void Simulation::reset(const MapModel *map, Player *player, QList<Enemy *> enemies)
+{
+    m_player = player;
+    m_pathFinder.reset(map);
+    m_proposals.clear();
+    m_proposals.reserve(enemies.size());
+
+    for (auto *const enemy : std::as_const(enemies))
+        m_proposals.append({enemy});
+
+    m_ticks = 0;
+}
+
+bool Simulation::isFinished() const
+{
+    return m_player.isNull() || !m_player->isAlive();
+}
+
+qint64 Simulation::step(qint64 count)
+{
+    auto steps = qint64{0};
+
+    for (; steps < count && !isFinished(); ++steps)
+        advance();
+
+    return steps;
+}
+
+void Simulation::advance()
+{
+    ++m_ticks;
+
+    m_pathFinder.setTarget(m_player->position());
+
+    const auto propose = [](Proposal &proposal) {
+        proposal.direction = proposal.enemy->propose();
+    };
+
+    if (m_proposals.size() >= ParallelThreshold)
+        QtConcurrent::blockingMap(m_proposals, propose);
+    else
+        std::for_each(m_proposals.begin(), m_proposals.end(), propose);
+
+    for (const auto &proposal : std::as_const(m_proposals))
+        proposal.enemy->perform(proposal.direction);
+}
+
+} // namespace GameOne
@@ -0,0 +1,56 @@
+#ifndef GAMEONE_SIMULATION_H
+#define GAMEONE_SIMULATION_H
+
+#include "actors.h"
+#include "pathfinder.h"
+
+#include <QList>
+#include <QPointer>
+
+namespace GameOne {
+
+// Advances the game world in discrete action ticks. The simulation owns no timers and
+// emits no signals on its own, so that it can be stepped faster than real time, e.g.
+// for balancing runs without an event loop. Backend::step() drives it, from the action
+// timer or for headless runs, and reports the actor changes of all steps in one batch.
+//
+// Each tick first lets all enemies propose their move, in parallel for large levels,
+// and then applies moves and attacks in the fixed order of the enemy list. Therefore
+// the outcome does not depend on the number of threads.
+//
+// Before the proposals the shared flow field is moved to the player's position,
+// so that proposing enemies can read it concurrently.
+class Simulation
+{
+public:
+    void reset(const MapModel *map, Player *player, QList<Enemy *> enemies);
+
+    PathFinder *pathFinder() { return &m_pathFinder; }
+    const PathFinder *pathFinder() const { return &m_pathFinder; }
+
+    auto ticks() const { return m_ticks; }
+    bool isFinished() const;
+
+    qint64 step(qint64 count = 1);
+
+    // below this number of enemies dispatching to the thread pool costs more than it saves
+    static constexpr qsizetype ParallelThreshold = 256;
+
+private:
+    struct Proposal
+    {
+        Enemy *enemy;
+        Actor::Direction direction = Actor::Direction::None;
+    };
+
+    void advance();
+
+    QPointer<Player> m_player;
+    QList<Proposal> m_proposals;
+    PathFinder m_pathFinder;
+    qint64 m_ticks = 0;
+};
+
+} // namespace GameOne
+
+#endif // GAMEONE_SIMULATION_H
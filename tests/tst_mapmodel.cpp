@@ -0,0 +1,112 @@
+#include "backend.h"
+#include "mapmodel.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace Qt::StringLiterals;
+
+namespace {
+
+void initResources()
+{
+    Q_INIT_RESOURCE(data); // must not be called from within a namespace
+}
+
+} // namespace
+
+namespace GameOne {
+
+class MapModelTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        initResources();
+        QVERIFY(m_directory.isValid());
+    }
+
+    void cellsInRect_data()
+    {
+        QTest::addColumn<QRect>("rect");
+        QTest::addColumn<QRect>("expectedRect");
+        QTest::addColumn<QList<bool>>("expectedWalkable");
+
+        // G is walkable grass, M an impassable mountain, P the player's start
+
+        QTest::newRow("inside")
+                << QRect{1, 1, 2, 2} << QRect{1, 1, 2, 2}
+                << QList{true, false, true, true};
+        QTest::newRow("clipped")
+                << QRect{2, 1, 5, 5} << QRect{2, 1, 2, 2}
+                << QList{false, true, true, true};
+        QTest::newRow("whole map")
+                << QRect{-1, -1, 10, 10} << QRect{0, 0, 4, 3}
+                << QList{true, true, false, true, true, true, false, true, false, true, true, true};
+        QTest::newRow("outside")
+                << QRect{10, 10, 2, 2} << QRect{}
+                << QList<bool>{};
+    }
+
+    void cellsInRect()
+    {
+        QFETCH(QRect, rect);
+        QFETCH(QRect, expectedRect);
+        QFETCH(QList<bool>, expectedWalkable);
+
+        auto backend = Backend{};
+        auto *const map = backend.map();
+        QVERIFY(loadMap(map, "GGMG\nGPMG\nMGGG\n"));
+
+        const auto cells = map->cellsInRect(rect);
+
+        QCOMPARE(cells.rows, expectedRect.height());
+        QCOMPARE(cells.tileTypes.size(), expectedWalkable.size());
+        QCOMPARE(cells.itemTypes.size(), expectedWalkable.size());
+        QCOMPARE(cells.walkable.size(), expectedWalkable.size());
+        QCOMPARE(cells.isStart.size(), expectedWalkable.size());
+
+        // the cells must match those of the model, row by row
+
+        auto i = qsizetype{0};
+
+        for (auto y = expectedRect.top(); y <= expectedRect.bottom(); ++y) {
+            for (auto x = expectedRect.left(); x <= expectedRect.right(); ++x, ++i) {
+                const auto column = static_cast<std::size_t>(x);
+
+                QCOMPARE(cells.tileTypes[i], map->tileTypesInRow(y)[column]);
+                QCOMPARE(cells.itemTypes[i], map->itemTypesInRow(y)[column]);
+                QCOMPARE(cells.walkable.testBit(i), expectedWalkable[i]);
+                QCOMPARE(cells.isStart.testBit(i), map->isStartAt({x, y}));
+            }
+        }
+
+        if (expectedRect.contains(1, 1)) {
+            const auto player = (1 - expectedRect.top()) * expectedRect.width() + (1 - expectedRect.left());
+            QCOMPARE(cells.tileTypes[player], map->typeIndex(u"Player"_s).value());
+            QVERIFY(cells.isStart.testBit(player));
+        }
+    }
+
+private:
+    bool loadMap(MapModel *map, const QByteArray &text)
+    {
+        auto file = QFile{m_directory.filePath("test.map.txt")};
+
+        if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(text) != text.size())
+            return false;
+
+        file.close();
+        return map->load(file.fileName(), MapModel::LegacyFormat);
+    }
+
+    QTemporaryDir m_directory;
+};
+
+} // namespace GameOne
+
+QTEST_GUILESS_MAIN(GameOne::MapModelTest)
+
+#include "tst_mapmodel.moc"
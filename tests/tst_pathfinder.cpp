@@ -0,0 +1,174 @@
+#include "backend.h"
+#include "mapmodel.h"
+#include "pathfinder.h"
+
+#include <QTemporaryDir>
+#include <QTest>
+
+namespace {
+
+void initResources()
+{
+    Q_INIT_RESOURCE(data); // must not be called from within a namespace
+}
+
+} // namespace
+
+namespace GameOne {
+
+class PathFinderTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        initResources();
+        QVERIFY(m_directory.isValid());
+    }
+
+    void findPath_data()
+    {
+        QTest::addColumn<QByteArray>("map");
+        QTest::addColumn<QPoint>("from");
+        QTest::addColumn<QPoint>("to");
+        QTest::addColumn<qsizetype>("expectedLength");
+
+        // G is walkable grass, M an impassable mountain
+
+        QTest::newRow("open")
+                << QByteArray{"GGG\nGGG\nGGG\n"}
+                << QPoint{0, 0} << QPoint{2, 2} << qsizetype{4};
+        QTest::newRow("wall")
+                << QByteArray{"GGMGG\nGGMGG\nGGMGG\nGGGGG\n"}
+                << QPoint{0, 0} << QPoint{4, 0} << qsizetype{10};
+        QTest::newRow("maze")
+                << QByteArray{"GMGGG\nGMGMG\nGMGMG\nGGGMG\n"}
+                << QPoint{0, 0} << QPoint{4, 3} << qsizetype{13};
+        QTest::newRow("same cell")
+                << QByteArray{"GGG\n"}
+                << QPoint{1, 0} << QPoint{1, 0} << qsizetype{0};
+        QTest::newRow("separated")
+                << QByteArray{"GMG\nGMG\nGMG\n"}
+                << QPoint{0, 0} << QPoint{2, 0} << qsizetype{-1};
+        QTest::newRow("blocked target")
+                << QByteArray{"GGG\nGGM\n"}
+                << QPoint{0, 0} << QPoint{2, 1} << qsizetype{-1};
+    }
+
+    void findPath()
+    {
+        QFETCH(QByteArray, map);
+        QFETCH(QPoint, from);
+        QFETCH(QPoint, to);
+        QFETCH(qsizetype, expectedLength);
+
+        auto backend = Backend{};
+        QVERIFY(loadMap(backend.map(), map));
+
+        auto pathFinder = PathFinder{};
+        pathFinder.reset(backend.map());
+
+        const auto path = pathFinder.findPath(from, to);
+
+        if (expectedLength < 0) {
+            QVERIFY(path.isEmpty());
+            return;
+        }
+
+        QCOMPARE(path.size(), expectedLength);
+
+        // every step moves to a walkable neighbour, the last one reaches the target
+
+        auto position = from;
+
+        for (const auto &next : path) {
+            QCOMPARE((next - position).manhattanLength(), 1);
+            QVERIFY(backend.map()->isWalkable(next));
+            position = next;
+        }
+
+        QCOMPARE(position, to);
+    }
+
+    void direction()
+    {
+        auto backend = Backend{};
+        QVERIFY(loadMap(backend.map(), "GGMGG\nGGMGG\nGGMGG\nGGGGG\n"));
+
+        auto pathFinder = PathFinder{};
+        pathFinder.reset(backend.map());
+        pathFinder.setTarget({4, 0});
+
+        QCOMPARE(pathFinder.distance({4, 0}), 0);
+        QCOMPARE(pathFinder.distance({0, 0}), 10);
+        QCOMPARE(pathFinder.distance({2, 0}), PathFinder::Unreachable);
+
+        // following the flow field leads around the wall
+
+        auto random = Random{1};
+        auto position = QPoint{0, 0};
+
+        for (auto steps = 0; position != pathFinder.target(); ++steps) {
+            QVERIFY(steps < 10);
+
+            const auto direction = pathFinder.direction(position, random);
+            QVERIFY(direction != Actor::Direction::None);
+            position += PathFinder::step(direction);
+        }
+
+        QCOMPARE(pathFinder.direction(pathFinder.target(), random), Actor::Direction::None);
+    }
+
+    void directionTies()
+    {
+        auto backend = Backend{};
+        QVERIFY(loadMap(backend.map(), "GGG\nGGG\nGGG\n"));
+
+        auto pathFinder = PathFinder{};
+        pathFinder.reset(backend.map());
+        pathFinder.setTarget({2, 2});
+
+        // moving right and moving down are equally good, both must be chosen
+
+        auto random = Random{1};
+        auto rightCount = 0;
+        auto downCount = 0;
+
+        for (auto i = 0; i < 64; ++i) {
+            switch (pathFinder.direction({0, 0}, random)) {
+            case Actor::Direction::Right:
+                ++rightCount;
+                break;
+            case Actor::Direction::Down:
+                ++downCount;
+                break;
+            default:
+                QFAIL("Not a step towards the target");
+            }
+        }
+
+        QVERIFY(rightCount > 0);
+        QVERIFY(downCount > 0);
+    }
+
+private:
+    bool loadMap(MapModel *map, const QByteArray &text)
+    {
+        auto file = QFile{m_directory.filePath("test.map.txt")};
+
+        if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(text) != text.size())
+            return false;
+
+        file.close();
+        return map->load(file.fileName(), MapModel::LegacyFormat);
+    }
+
+    QTemporaryDir m_directory;
+};
+
+} // namespace GameOne
+
+QTEST_GUILESS_MAIN(GameOne::PathFinderTest)
+
+#include "tst_pathfinder.moc"
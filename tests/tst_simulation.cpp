@@ -0,0 +1,162 @@
+#include "backend.h"
+#include "mapmodel.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QScopeGuard>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThread>
+#include <QThreadPool>
+
+namespace {
+
+void initResources()
+{
+    Q_INIT_RESOURCE(data); // must not be called from within a namespace
+}
+
+} // namespace
+
+namespace GameOne {
+
+class SimulationTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        initResources();
+        QVERIFY(m_directory.isValid());
+        QVERIFY(writeLevel());
+    }
+
+    void replay()
+    {
+        // the same seed must reproduce the same session bit for bit
+
+        const auto expected = run(Seed);
+        QCOMPARE(expected.steps, StepCount);
+
+        const auto actual = run(Seed);
+        QCOMPARE(actual.steps, expected.steps);
+        QCOMPARE(actual.positions, expected.positions);
+        QCOMPARE(actual.energies, expected.energies);
+    }
+
+    void threadCount()
+    {
+        static_assert(EnemyCount >= Simulation::ParallelThreshold);
+
+        // the outcome must not depend on how the proposals are spread over threads
+
+        auto *const threadPool = QThreadPool::globalInstance();
+        const auto maximumThreadCount = threadPool->maxThreadCount();
+        const auto restoreThreadCount = qScopeGuard([threadPool, maximumThreadCount] {
+            threadPool->setMaxThreadCount(maximumThreadCount);
+        });
+
+        threadPool->setMaxThreadCount(1);
+        const auto expected = run(Seed);
+        QCOMPARE(expected.steps, StepCount);
+
+        threadPool->setMaxThreadCount(std::max(4, QThread::idealThreadCount()));
+        const auto actual = run(Seed);
+        QCOMPARE(actual.steps, expected.steps);
+        QCOMPARE(actual.positions, expected.positions);
+        QCOMPARE(actual.energies, expected.energies);
+    }
+
+private:
+    static constexpr auto Seed = quint64{0x5eed};
+    static constexpr auto StepCount = qint64{64};
+    static constexpr auto Columns = 48;
+    static constexpr auto Rows = 48;
+    static constexpr auto EnemyCount = 400;
+
+    struct Outcome
+    {
+        qint64 steps = 0;
+        QList<QPoint> positions;
+        QList<int> energies;
+    };
+
+    // an open field with a few walls, the player in its center and enough
+    // enemies around it, so that the proposals are run on the thread pool
+
+    bool writeLevel()
+    {
+        auto map = QByteArray{};
+
+        for (auto row = 0; row < Rows; ++row) {
+            for (auto column = 0; column < Columns; ++column)
+                map += (row % 8 == 4 && column % 12 < 8) ? 'M' : 'G';
+
+            map += '\n';
+        }
+
+        auto mapFile = QFile{m_directory.filePath("test.map.txt")};
+
+        if (!mapFile.open(QFile::WriteOnly) || mapFile.write(map) != map.size())
+            return false;
+
+        auto enemies = QJsonArray{};
+
+        // the enemies are spread over the even rows, since 7 is coprime
+        // to their number of cells, no cell is picked twice
+
+        for (auto i = 0; enemies.size() < EnemyCount; ++i) {
+            const auto cell = i * 7 % (Columns * Rows / 2);
+            const auto x = cell % Columns;
+            const auto y = cell / Columns * 2;
+
+            if (map[y * (Columns + 1) + x] == 'G' && (x != Columns / 2 || y != Rows / 2))
+                enemies.append(QJsonObject{{"x", x}, {"y", y}, {"maximumEnergy", 1 + i % 5}});
+        }
+
+        const auto level = QJsonObject{
+            {"levelName", "Simulation"},
+            {"map", QJsonObject{{"format", MapModel::LegacyFormat}, {"filename", mapFile.fileName()}}},
+            {"enemies", enemies},
+            {"player", QJsonObject{
+                 {"x", Columns / 2}, {"y", Rows / 2},
+                 {"maximumLives", 1000}, {"maximumEnergy", 1000},
+             }},
+        };
+
+        auto levelFile = QFile{levelFileName()};
+        const auto json = QJsonDocument{level}.toJson();
+
+        return levelFile.open(QFile::WriteOnly) && levelFile.write(json) == json.size();
+    }
+
+    QString levelFileName() const { return m_directory.filePath("test.level.json"); }
+
+    Outcome run(quint64 seed)
+    {
+        auto backend = Backend{};
+        auto outcome = Outcome{};
+
+        if (!backend.load(levelFileName(), {}, seed))
+            return outcome;
+
+        outcome.steps = backend.step(StepCount);
+
+        for (const auto *const actor : backend.actors()) {
+            outcome.positions.append(actor->position());
+            outcome.energies.append(actor->energy());
+        }
+
+        return outcome;
+    }
+
+    QTemporaryDir m_directory;
+};
+
+} // namespace GameOne
+
+QTEST_GUILESS_MAIN(GameOne::SimulationTest)
+
+#include "tst_simulation.moc"